@@ -17,6 +17,9 @@
 #include <QApplication>
 #include <QDebug>
 #include <QMainWindow>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 #include <hpp/corbaserver/manipulation/client.hh>
 
 #include "hpp/plot/hpp-manipulation-graph.hh"
@@ -25,11 +28,56 @@ int main(int argc, char** argv) {
   QApplication a(argc, argv);
   QMainWindow window;
 
+  // Draw the graph, replay a pan and zoom path and print the frame times.
+  bool benchmark = false;
+  // Write the graph with its statistics to a PNG or PDF file and exit,
+  // without showing a window. With QT_QPA_PLATFORM=offscreen, no display
+  // is needed.
+  const char* exportFile = NULL;
+  double scale = 2;
+  // Show a snapshot instead of connecting to the server.
+  const char* snapshot = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--benchmark") == 0)
+      benchmark = true;
+    else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+      exportFile = argv[++i];
+    else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+      scale = atof(argv[++i]);
+    else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc)
+      snapshot = argv[++i];
+  }
+
   hpp::corbaServer::manipulation::Client client(argc, argv);
-  client.connect();
-  hpp::plot::HppManipulationGraphWidget w(&client, NULL);
+  if (snapshot == NULL) client.connect();
+  hpp::plot::HppManipulationGraphWidget w((snapshot == NULL) ? &client : NULL,
+                                          NULL);
+  if (snapshot != NULL && !w.loadSnapshot(snapshot)) {
+    std::cerr << "Could not read " << snapshot << std::endl;
+    return 1;
+  }
+  if (exportFile != NULL) {
+    if (snapshot == NULL) {
+      w.updateGraph();
+      w.updateStatistics();
+    }
+    if (!w.exportImage(exportFile, scale)) {
+      std::cerr << "Could not write " << exportFile << std::endl;
+      return 1;
+    }
+    return 0;
+  }
   w.setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
   window.setCentralWidget(&w);
   window.show();
+  if (benchmark) {
+    w.updateGraph();
+    a.processEvents();
+    hpp::plot::GraphView::FrameStats stats = w.view()->benchmark(500);
+    std::cout << "frames: " << stats.frames << "\nmean: " << stats.mean
+              << " ms\np50: " << stats.p50 << " ms\np99: " << stats.p99
+              << " ms\nmax: " << stats.max << " ms" << std::endl;
+    return 0;
+  }
   return a.exec();
 }
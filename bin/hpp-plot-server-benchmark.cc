@@ -0,0 +1,168 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Measure the throughput and the latency of the server of hpp-manipulation
+// under concurrent clients, each polling the statistics of the constraint
+// graph as the monitoring widget does.
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QList>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtGlobal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QtConcurrent>
+#else
+#include <QtCore>
+#endif
+
+#include <hpp/corbaserver/manipulation/client.hh>
+#include <hpp/plot/call-stats.hh>
+
+namespace {
+struct Load {
+  QByteArray iiop, context;
+  QVector< ::hpp::ID> nodes;
+  qint64 duration;
+  QAtomicInt requests, errors;
+  hpp::plot::LatencyHistogram latency;
+};
+
+void client(Load* load, int index) {
+  hpp::corbaServer::manipulation::Client manip(0, 0);
+  try {
+    manip.connect(load->iiop.constData(), load->context.constData());
+  } catch (const CORBA::Exception& e) {
+    std::cerr << "client " << index << ": " << e._name() << std::endl;
+    return;
+  }
+  hpp::ConfigProjStat configStat, pathStat;
+  QElapsedTimer clock, timer;
+  clock.start();
+  for (int i = index; clock.elapsed() < load->duration; ++i) {
+    timer.start();
+    try {
+      manip.graph()->getConfigProjectorStats(
+          load->nodes[i % load->nodes.size()], configStat, pathStat);
+    } catch (const CORBA::Exception&) {
+      load->errors.fetchAndAddRelaxed(1);
+    }
+    load->latency.record((quint64)timer.nsecsElapsed());
+    load->requests.fetchAndAddRelaxed(1);
+  }
+}
+
+void usage(const char* name) {
+  std::cerr << "Usage: " << name
+            << " [--clients N] [--duration SECONDS] [--iiop URL]"
+               " [--context NAME]"
+            << std::endl;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  Load load;
+  QByteArray host("localhost"), port("13331");
+  QByteArray env = qgetenv("HPP_HOST");
+  if (!env.isNull()) host = env;
+  env = qgetenv("HPP_PORT");
+  if (!env.isNull()) port = env;
+  load.iiop = "corbaloc:iiop:" + host + ":" + port;
+  load.context = "corbaserver";
+  load.duration = 10000;
+  int nbClients = qMax(1, QThread::idealThreadCount());
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 == argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(argv[i], "--clients") == 0)
+      nbClients = qMax(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--duration") == 0)
+      load.duration = (qint64)(atof(argv[++i]) * 1000);
+    else if (strcmp(argv[i], "--iiop") == 0)
+      load.iiop = argv[++i];
+    else if (strcmp(argv[i], "--context") == 0)
+      load.context = argv[++i];
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  try {
+    hpp::corbaServer::manipulation::Client manip(0, 0);
+    manip.connect(load.iiop.constData(), load.context.constData());
+    hpp::GraphComp_var graph;
+    hpp::GraphElements_var elmts;
+    manip.graph()->getGraph(graph.out(), elmts.out());
+    for (CORBA::ULong i = 0; i < elmts->nodes.length(); ++i)
+      if (elmts->nodes[i].id > graph->id)
+        load.nodes.append(elmts->nodes[i].id);
+  } catch (const CORBA::Exception& e) {
+    std::cerr << "Cannot get the graph: " << e._name() << std::endl;
+    return 1;
+  }
+  if (load.nodes.isEmpty()) {
+    std::cerr << "The graph has no node." << std::endl;
+    return 1;
+  }
+
+  QThreadPool::globalInstance()->setMaxThreadCount(nbClients);
+  QElapsedTimer timer;
+  timer.start();
+  QList<QFuture<void> > futures;
+  for (int i = 0; i < nbClients; ++i)
+    futures.append(QtConcurrent::run(client, &load, i));
+  foreach (QFuture<void> f, futures) f.waitForFinished();
+  double seconds = (double)timer.elapsed() * 1e-3;
+
+  const hpp::plot::LatencyHistogram& h = load.latency;
+  quint64 n = h.count();
+  std::cout << "clients: " << nbClients << "\nrequests: " << n
+            << "\nerrors: " << load.errors.loadAcquire()
+            << "\nrequests/s: " << (seconds > 0 ? (double)n / seconds : 0.)
+            << "\nmean: "
+            << ((n > 0) ? (double)h.total() / (double)n * 1e-3 : 0.)
+            << " us\np50: " << (double)h.percentile(.5) * 1e-3
+            << " us\np99: " << (double)h.percentile(.99) * 1e-3
+            << " us\np999: " << (double)h.percentile(.999) * 1e-3
+            << " us\nmax: " << (double)h.max() * 1e-3 << " us" << std::endl;
+  return 0;
+}
@@ -0,0 +1,65 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HPP_PLOT_CALL_STATS_WIDGET_HH
+#define HPP_PLOT_CALL_STATS_WIDGET_HH
+
+#include <QTreeWidget>
+#include <QWidget>
+
+class QTimer;
+
+namespace hpp {
+namespace plot {
+/// Live view of the CallStats. It also controls the Tracer.
+class CallStatsWidget : public QWidget {
+  Q_OBJECT
+
+ public:
+  CallStatsWidget(QWidget* parent = NULL);
+
+ public slots:
+  void refresh();
+  void reset();
+  /// Ask for a file and dump the statistics into it.
+  void dump();
+  void enableTracing(bool enable);
+  /// Ask for a file and write the trace events recorded so far into it.
+  void saveTrace();
+
+ private:
+  QTreeWidget* table_;
+  QTimer* timer_;
+};
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_CALL_STATS_WIDGET_HH
@@ -0,0 +1,208 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HPP_PLOT_CALL_STATS_HH
+#define HPP_PLOT_CALL_STATS_HH
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <cstring>
+
+#include <hpp/plot/circuit-breaker.hh>
+#include <hpp/plot/tracer.hh>
+
+class QTextStream;
+
+namespace hpp {
+namespace plot {
+/// Histogram of durations, in nanoseconds, with a bounded relative error.
+///
+/// Values below 2^SubBucketBits are counted exactly. Above, each power of
+/// two is split into 2^SubBucketBits buckets, which gives a relative
+/// error below 1 / 2^SubBucketBits. Recording is lock-free.
+class LatencyHistogram {
+ public:
+  enum {
+    SubBucketBits = 4,
+    SubBuckets = 1 << SubBucketBits,
+    NbBuckets = (64 - SubBucketBits + 1) * SubBuckets
+  };
+
+  LatencyHistogram() { reset(); }
+
+  void record(quint64 ns);
+  void reset();
+
+  quint64 count() const { return count_.load(std::memory_order_relaxed); }
+  quint64 max() const { return max_.load(std::memory_order_relaxed); }
+  quint64 total() const { return total_.load(std::memory_order_relaxed); }
+  /// \param p in [0, 1]
+  /// \return the highest value equivalent to the p-quantile.
+  quint64 percentile(double p) const;
+
+  static int index(quint64 ns);
+  /// Highest value of the bucket.
+  static quint64 value(int index);
+
+ private:
+  std::atomic<quint64> buckets_[NbBuckets];
+  std::atomic<quint64> count_, max_, total_;
+};
+
+/// Statistics of the calls made to the HPP servers, per method.
+class CallStats {
+ public:
+  struct Method {
+    QString name;
+    /// name, as expected by the Tracer.
+    QByteArray traceName;
+    std::atomic<quint64> calls, errors, bytes;
+    LatencyHistogram latency;
+
+    Method(const QString& n)
+        : name(n), traceName(n.toUtf8()), calls(0), errors(0), bytes(0) {}
+    void reset();
+  };
+
+  static CallStats& instance();
+
+  /// Get or create the statistics of a method.
+  /// The returned pointer remains valid until the program exits.
+  Method* method(const QString& name);
+  QList<Method*> methods() const;
+
+  void reset();
+
+  /// Write a table of the statistics, one line per method.
+  void dump(QTextStream& os) const;
+  bool dump(const QString& filename) const;
+
+ private:
+  CallStats() {}
+
+  mutable QMutex mutex_;
+  QMap<QString, Method*> methods_;
+};
+
+/// Record the duration of a call and whether failed() was called.
+/// The call is also traced when the Tracer is enabled.
+class ScopedCall {
+ public:
+  ScopedCall(CallStats::Method* method)
+      : method_(method),
+        traceStart_(Tracer::enabled() ? Tracer::instance().now() : -1),
+        failed_(false) {
+    timer_.start();
+  }
+
+  ~ScopedCall() {
+    qint64 ns = timer_.nsecsElapsed();
+    method_->latency.record((quint64)ns);
+    method_->calls.fetch_add(1, std::memory_order_relaxed);
+    if (failed_)
+      method_->errors.fetch_add(1, std::memory_order_relaxed);
+    if (traceStart_ >= 0)
+      Tracer::instance().record(method_->traceName.constData(), "corba",
+                                traceStart_, ns / 1000);
+  }
+
+  /// The call threw.
+  void failed() { failed_ = true; }
+
+ private:
+  CallStats::Method* method_;
+  QElapsedTimer timer_;
+  qint64 traceStart_;
+  bool failed_;
+};
+
+/// Evaluate f and record it, without going through the CircuitBreaker.
+template <typename F>
+auto recordedCall(CallStats::Method* method, F f) -> decltype(f()) {
+  ScopedCall call(method);
+  try {
+    return f();
+  } catch (...) {
+    call.failed();
+    throw;
+  }
+}
+
+/// Calls rejected by the CircuitBreaker are not recorded.
+template <typename F>
+auto timedCall(CallStats::Method* method, F f) -> decltype(f()) {
+  return guardedCall(
+      [&]() -> decltype(f()) { return recordedCall(method, f); });
+}
+
+/// Size in bytes of an element of a sequence of the IDL.
+template <typename T>
+quint64 elementBytes(const T&) {
+  return sizeof(T);
+}
+/// The characters of a string, not the size of its pointer.
+inline quint64 elementBytes(const _CORBA_String_element& s) {
+  const char* str = s.in();
+  return (str == NULL) ? 1 : std::strlen(str) + 1;
+}
+
+/// Size in bytes of a sequence of the IDL.
+template <typename Seq>
+quint64 seqBytes(const Seq& seq) {
+  quint64 bytes = 0;
+  for (_CORBA_ULong i = 0; i < seq.length(); ++i) bytes += elementBytes(seq[i]);
+  return bytes;
+}
+}  // namespace plot
+}  // namespace hpp
+
+/// The statistics of method \c name. The lookup is done once per call site.
+#define HPP_PLOT_METHOD(name)                                      \
+  ([]() -> ::hpp::plot::CallStats::Method* {                       \
+    static ::hpp::plot::CallStats::Method* m =                     \
+        ::hpp::plot::CallStats::instance().method(QString(name)); \
+    return m;                                                      \
+  }())
+
+/// Evaluate \c expr, a call to the server, and record it as method \c name.
+/// Throws CORBA::TRANSIENT at once while the CircuitBreaker is open.
+#define HPP_PLOT_CALL(name, expr) \
+  ::hpp::plot::timedCall(HPP_PLOT_METHOD(name), [&]() { return expr; })
+
+/// Add n bytes to the data transferred by method \c name.
+#define HPP_PLOT_CALL_BYTES(name, n) \
+  HPP_PLOT_METHOD(name)->bytes.fetch_add((n), std::memory_order_relaxed)
+
+#endif  // HPP_PLOT_CALL_STATS_HH
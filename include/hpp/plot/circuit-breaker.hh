@@ -0,0 +1,150 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef HPP_PLOT_CIRCUIT_BREAKER_HH
+#define HPP_PLOT_CIRCUIT_BREAKER_HH
+
+#include <omniORB4/CORBA.h>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <functional>
+
+namespace hpp {
+namespace plot {
+/// Stops calling the server once it looks unreachable.
+///
+/// After threshold() consecutive calls failed with TRANSIENT, COMM_FAILURE
+/// or TIMEOUT, the breaker opens: the calls made through HPP_PLOT_CALL
+/// fail at once with CORBA::TRANSIENT instead of waiting for the server.
+/// After a cooldown, a single call is let through as a probe, or the probe
+/// given to setProbe() is called in the background. If it succeeds, the
+/// breaker closes. Otherwise, it opens again for twice the cooldown, up to
+/// maxCooldown().
+///
+/// The methods are thread safe.
+class CircuitBreaker : public QObject {
+  Q_OBJECT
+
+ public:
+  enum State { Closed, Open, HalfOpen };
+
+  /// Report a success when destroyed, unless unreachable() was called.
+  class Answer {
+   public:
+    Answer(CircuitBreaker& breaker) : breaker_(breaker), failed_(false) {}
+    ~Answer() {
+      if (failed_)
+        breaker_.failure();
+      else
+        breaker_.success();
+    }
+    void unreachable() { failed_ = true; }
+
+   private:
+    CircuitBreaker& breaker_;
+    bool failed_;
+  };
+
+  /// Throws when the server does not answer.
+  typedef std::function<void()> Probe;
+
+  static CircuitBreaker& instance();
+
+  /// Whether a call may be made now. In the half open state, only the
+  /// first caller gets true.
+  bool allow();
+  /// The server answered, possibly with an hpp::Error.
+  void success();
+  /// The server could not be reached.
+  void failure();
+  /// Close the breaker, for instance after connecting again.
+  void reset();
+  /// Once the cooldown is over, call probe from a thread of the global
+  /// QThreadPool instead of letting a call through: the calls made from the
+  /// interface thread never wait for the half open probe.
+  /// \param probe may be empty.
+  void setProbe(const Probe& probe);
+
+  State state() const;
+  bool reachable() const { return state() == Closed; }
+
+  int threshold() const { return threshold_; }
+  void setThreshold(int n) { threshold_ = qMax(1, n); }
+  /// \param msec initial and maximal cooldown.
+  void setCooldown(qint64 msec, qint64 maxMsec);
+  qint64 maxCooldown() const { return maxCooldown_; }
+
+  /// Whether the exception means the server could not be reached.
+  static bool isUnreachable(const CORBA::Exception& e);
+
+ signals:
+  /// Emitted from the thread of the call that changed the state.
+  void reachableChanged(bool reachable);
+
+ private:
+  CircuitBreaker();
+  /// Must be called with mutex_ locked.
+  /// \return whether reachable() changed.
+  bool setState(State state);
+  /// Call probe and report whether the server answered.
+  void runProbe(Probe probe);
+
+  mutable QMutex mutex_;
+  State state_;
+  int failures_, threshold_;
+  bool probing_;
+  qint64 cooldown_, initialCooldown_, maxCooldown_;
+  QElapsedTimer opened_;
+  Probe probe_;
+};
+
+/// Evaluate f unless the circuit breaker is open, and report whether the
+/// server answered.
+template <typename F>
+auto guardedCall(F f) -> decltype(f()) {
+  CircuitBreaker& breaker = CircuitBreaker::instance();
+  if (!breaker.allow()) throw CORBA::TRANSIENT(0, CORBA::COMPLETED_NO);
+  // Destroyed after the handler, on return or once the exception leaves.
+  CircuitBreaker::Answer answer(breaker);
+  try {
+    return f();
+  } catch (const CORBA::Exception& e) {
+    if (CircuitBreaker::isUnreachable(e)) answer.unreachable();
+    throw;
+  }
+}
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_CIRCUIT_BREAKER_HH
@@ -34,21 +34,157 @@
 
 #include <QGVScene.h>
 
+#include <QAction>
 #include <QComboBox>
+#include <QElapsedTimer>
 #include <QGraphicsScene>
 #include <QGraphicsView>
+#include <QMap>
+#include <QMenu>
+#include <QPair>
+#include <QPixmap>
+#include <QSet>
 #include <QTextEdit>
+#include <QTimer>
+#include <QTransform>
+#include <QVector>
 #include <QWidget>
 
 namespace hpp {
 namespace plot {
 class GraphView : public QGraphicsView {
  public:
+  /// Frame times, in milliseconds.
+  struct FrameStats {
+    int frames;
+    double mean, p50, p99, max;
+  };
+
   GraphView(QWidget* parent = NULL);
 
+  /// Show an overlay with the frame time, the number of painted items,
+  /// the cost of painting the edges and the time spent querying the scene
+  /// index.
+  void showHud(bool show);
+  bool hudVisible() const { return hud_; }
+
+  /// Replay a fixed pan and zoom path over the scene, painting
+  /// synchronously at each step. The view is restored afterwards.
+  FrameStats benchmark(int steps = 200);
+
+  /// When the level of detail of the view is below threshold, the nodes
+  /// and edges are hidden and replaced by filled ellipses and straight
+  /// lines, without labels nor antialiasing.
+  void setLevelOfDetail(bool enable, qreal threshold = .35);
+  bool levelOfDetail() const { return lod_; }
+
+  /// Register the end nodes of an edge, to draw it simplified.
+  void addEdgeEnds(QGVEdge* edge, QGVNode* start, QGVNode* end);
+  /// Forget the registered items. Must be called when the scene is cleared.
+  void clearItems();
+  /// Set up the item caches and the scene index once the layout is done.
+  void prepareItems();
+  /// The simplified drawing will be recomputed at the next paint.
+  /// Call it when the items moved or changed color.
+  void invalidateLod() { lodDirty_ = true; }
+  /// Whether the items are hidden and replaced by the simplified drawing.
+  bool simplified() const { return simplified_; }
+  /// Draw the nodes of the scene intersecting rect as ellipses and the
+  /// edges as straight lines.
+  void drawSimplified(QPainter* painter, const QRectF& rect);
+
+  /// Call QGVNode::updateLayout when the items are shown again.
+  void deferLayout(QGVNode* node) { staleNodes_.insert(node); }
+  void deferLayout(QGVEdge* edge) { staleEdges_.insert(edge); }
+
+  /// Show the items hidden by the simplified drawing, until the next call
+  /// to updateLevelOfDetail. Call it before rendering the scene outside of
+  /// the view.
+  void showAllItems() { setSimplified(false); }
+  /// Hide or show the items according to the zoom of the view. Call it
+  /// after changing the transform of the view.
+  void updateLevelOfDetail();
+
+  /// While nodes are dragged, their edges are hidden and drawn as straight
+  /// lines. Call this once the edges have been routed again.
+  void endDragPreview();
+  /// Edges of the nodes moved since the last endDragPreview.
+  const QList<QGVEdge*>& dragEdges() const { return dragEdges_; }
+
   // QWidget interface
  protected:
   void wheelEvent(QWheelEvent*);
+  /// Holding Shift selects the items with a rubber band instead of
+  /// scrolling.
+  void mousePressEvent(QMouseEvent*);
+  void mouseMoveEvent(QMouseEvent*);
+  void mouseReleaseEvent(QMouseEvent*);
+  void paintEvent(QPaintEvent*);
+  void drawBackground(QPainter* painter, const QRectF& rect);
+  void drawForeground(QPainter* painter, const QRectF& rect);
+
+ private:
+  void setSimplified(bool simplified);
+  void buildLod();
+
+  /// Estimate the time spent painting the edge splines and the edge
+  /// labels, by painting a sample of the edges offscreen.
+  void measureEdgeCost(const QList<QGraphicsItem*>& items);
+
+  bool hud_;
+  ViewportUpdateMode updateMode_;
+  /// In milliseconds.
+  double frameTime_, meanFrameTime_, queryTime_, splineTime_, labelTime_;
+  int nbItems_, nbEdges_;
+  QElapsedTimer lastCostMeasure_;
+
+  bool lod_, simplified_, lodDirty_, antialiasing_;
+  qreal lodThreshold_;
+  QMap<QGVEdge*, QPair<QGVNode*, QGVNode*> > edgeEnds_;
+  /// Simplified drawing.
+  QVector<QRectF> lodNodes_;
+  QVector<QColor> lodNodeColors_;
+  QMap<QRgb, QVector<QLineF> > lodEdges_;
+  /// Hidden items whose attributes changed.
+  QSet<QGVNode*> staleNodes_;
+  QSet<QGVEdge*> staleEdges_;
+
+  /// Edges incident to the dragged nodes.
+  QList<QGVEdge*> dragEdges_;
+  bool dragging_, previewing_;
+};
+
+/// Thumbnail of the whole scene showing the area seen in a GraphView.
+/// Clicking or dragging in it moves the view.
+///
+/// The simplified drawing of the scene is cached in a pixmap, which is only
+/// drawn again after invalidate() or a resize. Moving the view only
+/// repaints the rectangle over the pixmap.
+class GraphOverview : public QWidget {
+ public:
+  GraphOverview(GraphView* view, QWidget* parent = NULL);
+
+  /// Draw the scene again at the next paint. Call it when the layout or the
+  /// colors of the items change.
+  void invalidate();
+
+ protected:
+  void paintEvent(QPaintEvent*);
+  void mousePressEvent(QMouseEvent*);
+  void mouseMoveEvent(QMouseEvent*);
+
+ private:
+  void render();
+  /// Center the view on the scene point under pos.
+  void moveView(const QPointF& pos);
+
+  GraphView* view_;
+  QPixmap pixmap_;
+  bool dirty_;
+  /// From the scene to the widget.
+  QTransform transform_;
+  /// From the pointer to the center of the rectangle of the view.
+  QPointF grabOffset_;
 };
 
 class GraphWidget : public QWidget {
@@ -59,10 +195,33 @@ class GraphWidget : public QWidget {
 
   ~GraphWidget();
 
+  /// Add a button triggering the action next to the other buttons.
+  void addButton(QAction* action);
+
+  GraphView* view() const { return view_; }
+
+  /// Render the graph, with its current colors, to a PNG image with scale
+  /// pixels per point or to a PDF file. See exportScene.
+  bool exportImage(const QString& filename, qreal scale = 2);
+
  public slots:
   void updateGraph();
+  /// Route all the edges again with the current node positions.
   void updateEdges();
+  /// Route again the edges of the nodes moved since the last routing. The
+  /// other edges keep their splines.
+  void updateMovedEdges();
   void saveDotFile();
+  /// Ask for a file and export the graph to it.
+  void saveImage();
+  /// Call updateMovedEdges after some delay. Successive calls are merged, so
+  /// that dragging several nodes in a row costs one routing. Until then,
+  /// the view only previews the moved edges as straight lines.
+  void scheduleEdgeUpdate();
+  void showFrameStats(bool show);
+  void enableLevelOfDetail(bool enable);
+  /// Run GraphView::benchmark and show the result.
+  void benchmarkView();
 
  protected slots:
   virtual void nodeContextMenu(QGVNode* node);
@@ -72,6 +231,21 @@ class GraphWidget : public QWidget {
 
  protected:
   virtual void fillScene();
+  /// Clear the scene, fill it and lay it out with algorithm.
+  /// With "nop2", the nodes keep the positions set by fillScene and only
+  /// the edges are routed.
+  void layoutGraph(const QString& algorithm);
+  /// Add an edge to the scene. Use it instead of QGVScene::addEdge so that
+  /// the view knows the ends of the edge.
+  QGVEdge* addEdge(QGVNode* start, QGVNode* end, const QString& label);
+  /// Add a widget to the panel next to the view, above the overview.
+  void addInfoWidget(QWidget* widget);
+  /// Redraw an item after changing its style attributes (color,
+  /// fillcolor, penwidth, style...). While the view is simplified, the
+  /// item is hidden and QGVNode::updateLayout is deferred until it is
+  /// shown again.
+  void updateStyle(QGVNode* node);
+  void updateStyle(QGVEdge* edge);
   QGVScene* scene_;
   QWidget* buttonBox_;
   QTextEdit* elmtInfo_;
@@ -80,8 +254,18 @@ class GraphWidget : public QWidget {
 
  private:
   GraphView* view_;
+  GraphOverview* overview_;
+  QMenu* viewMenu_;
+  QTimer* edgeUpdateTimer_;
   QComboBox* algList_;
   bool layoutShouldBeFreed_;
+
+  /// Route edges again with "nop2". The other edges keep their splines:
+  /// "nop2" only routes the edges without a "pos" attribute.
+  void routeEdges(const QList<QGVEdge*>& edges);
+  /// Store the splines of the last layout in the "pos" attribute of the
+  /// edges, so that the next "nop2" layout keeps them.
+  void attachEdgeSplines();
 };
 }  // namespace plot
 }  // namespace hpp
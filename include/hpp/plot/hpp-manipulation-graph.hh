@@ -33,9 +33,20 @@
 #define HPP_PLOT_HPP_MANIPULATION_GRAPH_HH
 
 #include <QAction>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPointF>
 #include <QPushButton>
+#include <QSet>
+#include <QSpinBox>
+#include <QUndoStack>
 #include <hpp/corbaserver/manipulation/client.hh>
 #include <hpp/plot/graph-widget.hh>
+#include <hpp/plot/search-index.hh>
 
 namespace hpp {
 namespace corbaServer {
@@ -66,6 +77,28 @@ class HppManipulationGraphWidget : public GraphWidget {
   Q_OBJECT
 
  public:
+  /// Numerical key of the color of an element: either a success rate
+  /// scaled to [0, 255] or one of these values.
+  enum ColorKey {
+    DefaultColor = -1,
+    HighlightColor = -2,
+    IncreaseColor = -3,
+    DecreaseColor = -4,
+    /// DeltaColor + d, with d in [-255, 255]: change of the success rate
+    /// since the baseline of the comparison, scaled.
+    DeltaColor = 512
+  };
+  /// How the nodes are grouped into clusters.
+  enum ClusterMode {
+    NoClusters,
+    /// Nodes whose names share the part before the first " : ".
+    ClusterByPrefix,
+    /// Waypoint nodes of the same waypoint edge.
+    ClusterByWaypoints,
+    /// Connected components of the displayed graph.
+    ClusterByComponent
+  };
+
   HppManipulationGraphWidget(corbaServer::manipulation::Client* hpp_,
                              QWidget* parent);
 
@@ -74,12 +107,98 @@ class HppManipulationGraphWidget : public GraphWidget {
   void addNodeContextMenuAction(GraphAction* action);
   void addEdgeContextMenuAction(GraphAction* action);
 
+  /// Use another client and, unless it is NULL, draw the graph again.
+  /// The graph drawn before stays, marked as stale, while the client is
+  /// NULL.
   void client(corbaServer::manipulation::Client* hpp);
+  /// Other servers solving the same problem with the same graph. Their
+  /// statistics are polled in the background, each server in its own
+  /// thread, and either summed with those of the main client or shown one
+  /// at a time. A server that fails is polled again after a delay that
+  /// doubles at each failure. The widget owns the clients and deletes the
+  /// previous ones, once their polling is over.
+  void setInstances(const QList<corbaServer::manipulation::Client*>& others);
+  /// Add servers to those given to setInstances.
+  void addInstances(const QList<corbaServer::manipulation::Client*>& others);
+  /// \param index -1 for the sum over all the servers, 0 for the main
+  ///        client and i > 0 for the i-th other server.
+  void showInstance(int index);
 
   bool selectionID(hpp::ID& id);
   void showEdge(const hpp::ID& edgeId);
+  /// Color nodes and edges according to a success rate in [0, 1].
+  /// Elements absent from rates are left unchanged. The statistics do not
+  /// color the graph until hideSuccessRates is called.
+  void showSuccessRates(const QMap<hpp::ID, double>& rates);
+
+  /// Set the weights of several edges and refresh the style of these edges
+  /// only.
+  /// This does not go through the undo stack.
+  /// \return the weights the server accepted.
+  QMap<hpp::ID, ::CORBA::Long> setWeights(
+      const QMap<hpp::ID, ::CORBA::Long>& weights);
+  /// Set the weights of several edges as one undoable action. Nothing is
+  /// pushed to the undo stack when no weight could be set.
+  /// \return the weights the server accepted.
+  QMap<hpp::ID, ::CORBA::Long> pushWeights(
+      const QMap<hpp::ID, ::CORBA::Long>& weights, const QString& text);
+
+  /// Compute new edge weights from the statistics.
+  ///
+  /// Edges that often fail to generate a configuration get a lower weight.
+  /// Edges leading to nodes that are rare in the roadmap get a higher
+  /// weight. The suggested weight is the base weight of the edge, its
+  /// weight when the tuning started or when it was last edited by hand,
+  /// times a factor between 1/2 and 2 computed from the statistics. It
+  /// does not depend on the current weight, so that successive tunings
+  /// converge with the statistics. The weights stay within the tuning
+  /// bounds and edges with a null or negative weight are left unchanged.
+  /// \return the edges whose weight should change.
+  QMap<hpp::ID, ::CORBA::Long> suggestWeights() const;
+  void setTuningBounds(::CORBA::Long minWeight, ::CORBA::Long maxWeight);
+  /// Minimal number of observations of an edge before tuning its weight.
+  void setTuningMinObservations(int nbObs) { tuneMinObs_ = nbObs; }
+  /// \param msec period of the weight tuning.
+  void setTuningInterval(int msec);
   const std::string& graphName() const { return graphName_; }
 
+  /// Only show the elements at most hops edges away from a node or an
+  /// edge. The direction of the edges is ignored.
+  /// The graph fetched at the last refresh is used: this does not call the
+  /// server.
+  void focusOn(hpp::ID id, int hops);
+  /// Show the whole graph again. This does not call the server.
+  void clearFocus();
+  bool focused() const { return focusId_ >= 0; }
+
+  /// Write the graph, the positions of the nodes and the statistics to a
+  /// compressed file.
+  bool saveSnapshot(const QString& filename) const;
+  /// Show a snapshot at once, marked as stale, without calling the server
+  /// nor running the layout algorithm. When the next client is set, the
+  /// snapshot is kept if the graph of the server has the same revision
+  /// and fetched again otherwise.
+  bool loadSnapshot(const QString& filename);
+
+  /// Compare the statistics shown, live or from a snapshot, with those
+  /// of a snapshot, the baseline. The elements are colored by the change
+  /// of their success rate and the worst regressions are listed. The
+  /// comparison follows the statistics until stopComparison and does not
+  /// call the server.
+  /// \return false if the snapshot cannot be read.
+  bool compareWith(const QString& filename);
+  bool comparing() const { return !baselineName_.isEmpty(); }
+
+  /// Group the nodes into clusters. A collapsed cluster is drawn as a
+  /// single node whose statistics are the sum of those of its nodes. The
+  /// clusters are collapsed when the mode changes.
+  /// This does not call the server.
+  void setClusterMode(ClusterMode mode);
+  ClusterMode clusterMode() const;
+  /// Draw the nodes of a cluster in a subgraph.
+  void expandCluster(const QString& cluster);
+  void collapseCluster(const QString& cluster);
+
  protected:
   void fillScene();
 
@@ -89,6 +208,21 @@ class HppManipulationGraphWidget : public GraphWidget {
   void displayNodeConstraint(hpp::ID id);
   void displayEdgeConstraint(hpp::ID id);
   void displayEdgeTargetConstraint(hpp::ID id);
+  /// Open a dialog to set, scale or compute the weights of the selected
+  /// edges.
+  void editSelectedWeights();
+  /// Suggest new weights and, depending on the auto apply check box,
+  /// either apply them or preview them and ask for confirmation.
+  void tuneWeights();
+  /// Select the elements whose name, containing node or constraint names
+  /// contain all the words of query. The query may also contain
+  /// conditions on the statistics: "rate < 20%", "success rate >= .5",
+  /// "weight == 0", "freq > 10" or "obs < 20".
+  void search(const QString& query);
+  /// Color the elements by their statistics again.
+  void stopComparison();
+  /// Color the elements by their statistics, or by the comparison, again.
+  void hideSuccessRates();
 
  protected slots:
   virtual void nodeContextMenu(QGVNode* node);
@@ -100,6 +234,25 @@ class HppManipulationGraphWidget : public GraphWidget {
 
  private slots:
   void startStopUpdateStats(bool start);
+  void startStopTuning(bool start);
+  void toggleFocus(bool focus);
+  void focusOnSelection();
+  void setFocusHops(int hops);
+  void clusterModeChanged(int index);
+  void subGraphDoubleClick(QGVSubGraph* subGraph);
+  /// Search again and fit the results in the view.
+  void zoomToResults();
+  void instanceChanged(int index);
+  /// Store the statistics of another server when its poll is over.
+  void instancePolled();
+  /// Keep the stale graph or fetch it again, once reconcile is over.
+  void reconciled();
+  void regressionActivated(QListWidgetItem* item);
+  void openSnapshot();
+  void saveSnapshotAs();
+  void compareWithSnapshot();
+  /// Show or hide the warning, when the CircuitBreaker changes.
+  void serverReachable(bool reachable);
 
  private:
   corbaServer::manipulation::Client* manip_;
@@ -112,31 +265,182 @@ class HppManipulationGraphWidget : public GraphWidget {
     ::hpp::ID id;
     QString constraintStr;
     QGVNode* node;
+    /// See ColorKey.
+    int color;
 
     ::hpp::ConfigProjStat configStat, pathStat;
     ::CORBA::Long freq;
     ::hpp::intSeq_var freqPerCC;
+    /// Summary of freqPerCC shown in the info panel. Empty until computed,
+    /// and cleared when freqPerCC changes.
+    QString ccSummary;
+    /// Cluster of the node, null if none.
+    QString cluster;
+    /// Nodes of a collapsed cluster. Empty for a regular node.
+    QList< ::hpp::ID> members;
     NodeInfo();
   };
   struct EdgeInfo {
-    ::hpp::ID id;
+    ::hpp::ID id, start, end;
     QString name, containingNodeName;
     ::CORBA::Long weight;
     QString constraintStr;
     QString shortStr;
     QGVEdge* edge;
+    /// See ColorKey.
+    int color;
 
     ::hpp::ConfigProjStat configStat, pathStat;
     ::hpp::Names_t_var errors;
     ::hpp::intSeq_var freqs;
+    /// Edges merged into this one because they link collapsed clusters.
+    /// Empty for a regular edge.
+    QList< ::hpp::ID> members;
 
     EdgeInfo();
   };
 
+  /// What fillScene needs to know about the graph.
+  struct GraphCache {
+    struct Node {
+      ::hpp::ID id;
+      QString name, constraintStr;
+      QStringList constraints;
+      bool isWaypoint;
+    };
+    struct Edge {
+      ::hpp::ID id, start, end;
+      QString name, containingNodeName, constraintStr, shortStr;
+      QStringList constraints;
+      ::CORBA::Long weight;
+      QList< ::hpp::ID> waypoints;
+    };
+    bool valid;
+    /// Hash of the structure of the graph on the server.
+    QByteArray revision;
+    QList<Node> nodes;
+    QList<Edge> edges;
+    /// Index in nodes and edges from the element ID.
+    QMap< ::hpp::ID, int> nodeIndex, edgeIndex;
+
+    GraphCache() : valid(false) {}
+  };
+
+  /// Statistics of the elements, polled from one server.
+  struct PolledStats {
+    struct Node {
+      ::hpp::ConfigProjStat configStat, pathStat;
+      ::CORBA::Long freq;
+      QVector< ::CORBA::Long> freqPerCC;
+    };
+    struct Edge {
+      ::hpp::ConfigProjStat configStat, pathStat;
+      QStringList errors;
+      QVector< ::CORBA::Long> freqs;
+    };
+    QMap< ::hpp::ID, Node> nodes;
+    QMap< ::hpp::ID, Edge> edges;
+    /// Empty if all the calls succeeded.
+    QString error;
+    /// Whether error means that the server is unreachable.
+    bool unreachable;
+
+    PolledStats() : unreachable(false) {}
+  };
+
+  /// Get the statistics of nodes and edges from one server. Only the
+  /// statistics of the projector are fetched for the edges in configOnly.
+  /// Only the calls of the main client go through the CircuitBreaker, so
+  /// that another server being down does not stop the polling.
+  /// Can run in any thread that does not use the client at the same time.
+  static PolledStats pollStatistics(corbaServer::manipulation::Client* client,
+                                    bool main, QList< ::hpp::ID> nodes,
+                                    QList< ::hpp::ID> edges,
+                                    QList< ::hpp::ID> configOnly);
+  /// Sum the statistics of several servers. The roadmaps of the servers
+  /// differ, so their connected components are concatenated.
+  static PolledStats sumStatistics(const QList<PolledStats>& polled);
+
+  /// Content of a snapshot file.
+  struct Snapshot {
+    QString graphName, constraintStr;
+    ::hpp::ID graphId;
+    GraphCache cache;
+    QMap< ::hpp::ID, QPointF> positions;
+    PolledStats stats;
+  };
+  static bool readSnapshot(const QString& filename, Snapshot& snapshot);
+
+  /// Show the statistics of the elements, summed over their members for
+  /// collapsed clusters.
+  void applyStatistics(const PolledStats& stats);
+  /// Color the elements by the change of their statistics since
+  /// baseline_ and list the regressions.
+  void updateComparison();
+
+  /// A server other than manip_.
+  struct Instance {
+    corbaServer::manipulation::Client* client;
+    QFutureWatcher<PolledStats>* poll;
+    /// Statistics of the last poll.
+    PolledStats stats;
+    /// Whether the last poll failed. The server is not polled again before
+    /// retryDelay milliseconds after the failure.
+    bool failing;
+    qint64 retryDelay;
+    QElapsedTimer failure;
+  };
+  /// Delete an instance, once its poll is over.
+  void retire(Instance* instance);
+  /// Show the statistics of the last polls, according to instanceBox_.
+  void showPolledStatistics();
+
+  /// Get the graph from the server and fill cache_.
+  void fetchGraph();
+  /// Result of fetchWeights.
+  struct Reconciliation {
+    /// Revision of the graph of the server.
+    QByteArray revision;
+    /// Empty when the revision differs.
+    QMap< ::hpp::ID, ::CORBA::Long> weights;
+    /// Empty on success.
+    QString error;
+  };
+  /// Get the revision of the graph of the server and, if it is revision,
+  /// the weights of the edges.
+  /// Runs in a thread of the global QThreadPool.
+  static Reconciliation fetchWeights(corbaServer::manipulation::Client* client,
+                                     QByteArray revision,
+                                     QList< ::hpp::ID> edges);
+  /// Check in the background whether the graph of the server has the
+  /// revision of the stale graph. reconciled then keeps the stale graph
+  /// and updates its weights and statistics, or fetches the graph again.
+  void reconcile();
+  /// Index the elements of cache_.
+  void buildSearchIndex();
+  bool edgeVisible(const GraphCache::Edge& edge) const;
+  /// Nodes around focusId_.
+  QSet<hpp::ID> focusNodes() const;
+  /// Cluster of each of the given nodes, for the current cluster mode.
+  /// Nodes alone in their cluster are omitted.
+  QMap<hpp::ID, QString> clusters(const QSet<hpp::ID>& nodes) const;
+  /// Fill the scene again from cache_.
+  void redraw();
+  /// Sum the statistics of the members of a collapsed cluster.
+  static void aggregateStatistics(NodeInfo& ni, const PolledStats& stats);
+  static void aggregateStatistics(EdgeInfo& ei, const PolledStats& stats);
+
   void updateWeight(EdgeInfo& ei, bool get = true);
-  void updateWeight(EdgeInfo& ei, const ::CORBA::Long w);
+  /// Change the color of an element, if the key differs from the current
+  /// one.
+  void setColor(NodeInfo& ni, int key);
+  void setColor(EdgeInfo& ei, int key);
 
-  QString getConstraints(hpp::ID id);
+  QStringList getConstraintNames(hpp::ID id);
+  static QString formatConstraints(const QStringList& names);
+  QString getConstraints(hpp::ID id) {
+    return formatConstraints(getConstraintNames(id));
+  }
 
   std::string graphName_;
   QList<GraphAction*> nodeContextMenuActions_;
@@ -146,7 +450,52 @@ class HppManipulationGraphWidget : public GraphWidget {
   QMap<hpp::ID, QGVNode*> nodes_;
   QMap<hpp::ID, QGVEdge*> edges_;
 
-  QPushButton *showWaypoints_, *statButton_;
+  QPushButton *showWaypoints_, *statButton_, *weightsButton_;
+  QUndoStack* undoStack_;
+  QPushButton* tuneButton_;
+  QCheckBox* tuneAutoApply_;
+  QTimer* tuneTimer_;
+  ::CORBA::Long tuneMinWeight_, tuneMaxWeight_;
+  int tuneMinObs_;
+  /// Weight of each edge from which the tuning computes its weights.
+  QMap<hpp::ID, ::CORBA::Long> tuneBase_;
+  QPushButton* focusButton_;
+  QSpinBox* focusHops_;
+  GraphCache cache_;
+  /// When true, fillScene uses cache_ instead of calling the server.
+  bool useCache_;
+  /// Whether the colors of showSuccessRates are shown.
+  bool ratesShown_;
+  hpp::ID focusId_;
+  QComboBox* clusterMode_;
+  /// The clusters drawn as subgraphs. The others are collapsed.
+  QSet<QString> expanded_;
+  QMap<QGVSubGraph*, QString> subGraphs_;
+  QLineEdit* searchBox_;
+  QComboBox* instanceBox_;
+  QList<Instance*> instances_;
+  /// Instances removed while they were polled.
+  QList<Instance*> retired_;
+  /// Statistics of manip_ at the last poll.
+  PolledStats mainStats_;
+  QFutureWatcher<Reconciliation>* reconciling_;
+  /// The client reconcile was started with.
+  corbaServer::manipulation::Client* reconcileClient_;
+  QLabel* unreachable_;
+  /// Shown while the graph may differ from the one of the server.
+  QLabel* stale_;
+  /// Positions of the nodes given to fillScene by loadSnapshot.
+  QMap<hpp::ID, QPointF> snapshotPos_;
+  QPushButton* snapshotButton_;
+  QAction* stopComparison_;
+  QListWidget* regressions_;
+  /// Statistics compared with those shown.
+  PolledStats baseline_;
+  /// Empty when not comparing.
+  QString baselineName_;
+  SearchIndex searchIndex_;
+  /// ID of each document of searchIndex_.
+  QVector<hpp::ID> searchIds_;
   QTimer* updateStatsTimer_;
 
   hpp::ID currentId_, showNodeId_, showEdgeId_;
@@ -0,0 +1,61 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef HPP_PLOT_SCENE_EXPORT_HH
+#define HPP_PLOT_SCENE_EXPORT_HH
+
+#include <QString>
+
+class QGraphicsScene;
+
+namespace hpp {
+namespace plot {
+/// Render a scene to a file, without a view.
+///
+/// A file ending with ".pdf" gets a vector drawing with one point per unit
+/// of the scene. Otherwise, a PNG image is written with scale pixels per
+/// unit of the scene. The items are recorded once, then the image is
+/// rasterized in horizontal bands, in parallel, and each band is
+/// compressed into the file as soon as the bands above it are written.
+/// The memory used does not depend on the height of the image. It grows
+/// with its width: a PNG file is written row by row, so a band is at
+/// least one full row. The bands are 8 MB at most, or one row when a row
+/// is larger, and one band per thread is kept.
+///
+/// Must be called from the thread of the scene.
+/// \return false if the file cannot be written.
+bool exportScene(QGraphicsScene* scene, const QString& filename,
+                 qreal scale = 1);
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_SCENE_EXPORT_HH
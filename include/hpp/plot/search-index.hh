@@ -0,0 +1,96 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#ifndef HPP_PLOT_SEARCH_INDEX_HH
+#define HPP_PLOT_SEARCH_INDEX_HH
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace hpp {
+namespace plot {
+/// Case insensitive substring search over short texts.
+///
+/// Each document is indexed by the trigrams of its text. A query looks up
+/// the rarest trigram of its words and checks the few candidates with a
+/// substring search. Words shorter than three characters are checked on
+/// the candidates of the other words, or on all the documents when no
+/// word is long enough.
+class SearchIndex {
+ public:
+  void clear();
+  /// Index a document made of several fields.
+  /// \return the index of the document, used in the results of find.
+  int add(const QStringList& fields);
+  int size() const { return docs_.size(); }
+
+  /// Documents containing all the words of text, in increasing order.
+  /// An empty text matches all the documents.
+  QVector<int> find(const QString& text) const;
+
+ private:
+  static quint64 trigram(const QString& s, int i) {
+    return ((quint64)s[i].unicode() << 32) |
+           ((quint64)s[i + 1].unicode() << 16) | s[i + 2].unicode();
+  }
+
+  /// Lower case text of the documents, fields separated by new lines.
+  QVector<QString> docs_;
+  /// Documents containing each trigram, in increasing order.
+  QHash<quint64, QVector<int> > trigrams_;
+};
+
+/// A condition on a numerical property of an element, such as
+/// "rate < 20%" or "weight == 0".
+struct SearchFilter {
+  enum Operator { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+  QString field;
+  Operator op;
+  /// Percentages are divided by 100.
+  double value;
+
+  bool accepts(double v) const;
+
+  /// Remove the conditions from query.
+  /// \param fields the accepted field names, in lower case. A field name
+  ///        may contain spaces.
+  static QList<SearchFilter> extract(QString& query,
+                                     const QStringList& fields);
+};
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_SEARCH_INDEX_HH
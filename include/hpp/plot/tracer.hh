@@ -0,0 +1,141 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HPP_PLOT_TRACER_HH
+#define HPP_PLOT_TRACER_HH
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <atomic>
+
+class QTextStream;
+
+namespace hpp {
+namespace plot {
+/// Records durations in the Chrome trace event format, which can be opened
+/// in Perfetto or chrome://tracing.
+///
+/// Each thread writes into its own ring buffer, without locking. The
+/// buffers are drained by flush(). When a buffer is full, the new events
+/// are dropped. When tracing is disabled, recording an event costs an
+/// atomic load.
+///
+/// Setting the environment variable HPP_PLOT_TRACE enables the tracer at
+/// startup.
+class Tracer {
+ public:
+  struct Event {
+    /// Both must outlive the tracer. See intern.
+    const char* name;
+    const char* category;
+    /// Start and duration, in microseconds.
+    qint64 ts, dur;
+  };
+
+  /// Per thread storage of the events.
+  class Buffer;
+
+  static Tracer& instance();
+
+  static bool enabled() {
+    return instance().enabled_.load(std::memory_order_relaxed);
+  }
+  void enable(bool enable);
+
+  /// Time since the creation of the tracer, in microseconds.
+  qint64 now() const { return clock_.nsecsElapsed() / 1000; }
+
+  /// Record an event of the current thread.
+  void record(const char* name, const char* category, qint64 ts,
+              qint64 dur);
+
+  /// Get a string that remains valid until the program exits.
+  /// Meant for names that are not string literals. It takes a lock.
+  const char* intern(const QString& name);
+
+  /// Write the recorded events and clear the buffers.
+  /// \return the number of written events.
+  int flush(QTextStream& os);
+  /// \return the number of written events or -1 if the file cannot be
+  ///         opened.
+  int flush(const QString& filename);
+
+  /// Number of events dropped because a buffer was full.
+  quint64 dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  Tracer();
+  Buffer* buffer();
+
+  std::atomic<bool> enabled_;
+  std::atomic<quint64> dropped_;
+  QElapsedTimer clock_;
+
+  QMutex mutex_;
+  QList<Buffer*> buffers_;
+  QSet<QByteArray> strings_;
+  int nextTid_;
+};
+
+/// Record the lifetime of the object as an event.
+class TraceScope {
+ public:
+  TraceScope(const char* name, const char* category = "gui")
+      : name_(name),
+        category_(category),
+        start_(Tracer::enabled() ? Tracer::instance().now() : -1) {}
+
+  ~TraceScope() {
+    if (start_ < 0) return;
+    Tracer& t = Tracer::instance();
+    t.record(name_, category_, start_, t.now() - start_);
+  }
+
+ private:
+  const char* name_;
+  const char* category_;
+  qint64 start_;
+};
+}  // namespace plot
+}  // namespace hpp
+
+#define HPP_PLOT_TRACE_CAT(a, b) a##b
+#define HPP_PLOT_TRACE_VAR(line) HPP_PLOT_TRACE_CAT(_hpp_plot_trace_, line)
+
+/// Trace the rest of the enclosing scope. \c name must be a string literal.
+#define HPP_PLOT_TRACE(name) \
+  ::hpp::plot::TraceScope HPP_PLOT_TRACE_VAR(__LINE__)(name)
+
+#endif  // HPP_PLOT_TRACER_HH
@@ -0,0 +1,289 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "graphprofiler.hh"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHeaderView>
+#include <QList>
+#include <QTableWidget>
+#include <QtGlobal>
+#include <algorithm>
+#include <limits>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QtConcurrent>
+#else
+#include <QtCore>
+#endif
+
+#undef __robot_hh__
+#undef __problem_hh__
+#include <hpp/corbaserver/client.hh>
+#include <hpp/plot/call-stats.hh>
+
+#include "jobqueue.hh"
+
+namespace hpp {
+namespace plot {
+namespace {
+/// Sort numerically when the cell contains a number.
+class NumericItem : public QTableWidgetItem {
+ public:
+  NumericItem(double v, int precision = 3)
+      : QTableWidgetItem(QString::number(v, 'g', precision)), value_(v) {}
+  /// Shows every digit of v.
+  NumericItem(qint64 v) : QTableWidgetItem(QString::number(v)), value_(v) {}
+
+  bool operator<(const QTableWidgetItem& other) const {
+    const NumericItem* o = dynamic_cast<const NumericItem*>(&other);
+    if (o == NULL) return QTableWidgetItem::operator<(other);
+    return value_ < o->value_;
+  }
+
+ private:
+  double value_;
+};
+}  // namespace
+
+GraphProfiler::ElementStat::ElementStat()
+    : id(-1),
+      isEdge(false),
+      calls(0),
+      success(0),
+      noStart(0),
+      totalTime(0),
+      maxTime(0) {}
+
+double GraphProfiler::ElementStat::successRate() const {
+  return (calls > 0) ? (double)success / (double)calls
+                     : std::numeric_limits<double>::quiet_NaN();
+}
+
+double GraphProfiler::ElementStat::errorQuantile(double q) const {
+  if (errors.isEmpty()) return 0;
+  QVector<double> e(errors);
+  int k = qBound(0, (int)(q * (e.size() - 1) + .5), e.size() - 1);
+  std::nth_element(e.begin(), e.begin() + k, e.end());
+  return e[k];
+}
+
+void GraphProfiler::ElementStat::merge(const ElementStat& other) {
+  calls += other.calls;
+  success += other.success;
+  noStart += other.noStart;
+  totalTime += other.totalTime;
+  maxTime = std::max(maxTime, other.maxTime);
+  errors += other.errors;
+}
+
+GraphProfiler::GraphProfiler(const QByteArray& iiop, const QByteArray& context)
+    : iiop_(iiop), context_(context), nextSample_(0) {}
+
+bool GraphProfiler::run(int nbSamples, int nbClients, Job& job) {
+  stats_.clear();
+  nextSample_.storeRelease(0);
+
+  // Get the graph elements once.
+  QVector<Element> elements;
+  {
+    corbaServer::manipulation::Client manip(0, 0);
+    manip.connect(iiop_.constData(), context_.constData());
+    hpp::GraphComp_var graph;
+    hpp::GraphElements_var elmts;
+    HPP_PLOT_CALL("graph.getGraph",
+                  manip.graph()->getGraph(graph.out(), elmts.out()));
+    for (CORBA::ULong i = 0; i < elmts->nodes.length(); ++i) {
+      if (elmts->nodes[i].id <= graph->id) continue;
+      Element e;
+      e.id = elmts->nodes[i].id;
+      e.start = -1;
+      e.name = QString::fromLocal8Bit(elmts->nodes[i].name);
+      e.isEdge = false;
+      elements.append(e);
+    }
+    for (CORBA::ULong i = 0; i < elmts->edges.length(); ++i) {
+      if (elmts->edges[i].id <= graph->id) continue;
+      Element e;
+      e.id = elmts->edges[i].id;
+      e.start = elmts->edges[i].start;
+      e.name = QString::fromLocal8Bit(elmts->edges[i].name);
+      e.isEdge = true;
+      elements.append(e);
+    }
+  }
+
+  nbClients = qBound(1, nbClients, qMax(1, nbSamples));
+  QVector<Stats_t> partial(nbClients);
+  QList<QFuture<void> > futures;
+  for (int i = 0; i < nbClients; ++i)
+    futures.append(QtConcurrent::run(this, &GraphProfiler::worker,
+                                     &elements, nbSamples, &job, &partial[i]));
+  foreach (QFuture<void> f, futures) f.waitForFinished();
+
+  // Merge the statistics of each client.
+  foreach (const Element& e, elements) {
+    ElementStat& s = stats_[e.id];
+    s.id = e.id;
+    s.name = e.name;
+    s.isEdge = e.isEdge;
+  }
+  for (int i = 0; i < nbClients; ++i)
+    for (Stats_t::const_iterator it = partial[i].constBegin();
+         it != partial[i].constEnd(); ++it)
+      stats_[it.key()].merge(it.value());
+
+  job.message(QString("%1 samples on %2 elements")
+                  .arg(qMin(nbSamples, nextSample_.loadAcquire()))
+                  .arg(elements.size()));
+  return !job.isCancelled();
+}
+
+void GraphProfiler::worker(QVector<Element> const* elements, int nbSamples,
+                           Job* job, Stats_t* stats) {
+  corbaServer::Client basic(0, 0);
+  corbaServer::manipulation::Client manip(0, 0);
+  try {
+    basic.connect(iiop_.constData(), context_.constData());
+    manip.connect(iiop_.constData(), context_.constData());
+  } catch (const CORBA::Exception& e) {
+    job->message(QString("%1 : %2").arg(e._name()).arg(e._rep_id()));
+    job->cancel();
+    return;
+  }
+
+  QElapsedTimer timer;
+  hpp::floatSeq_var res;
+  ::CORBA::Double error;
+  try {
+    while (!job->isCancelled() &&
+           nextSample_.fetchAndAddOrdered(1) < nbSamples) {
+      hpp::floatSeq_var q = HPP_PLOT_CALL(
+          "robot.shootRandomConfig", basic.robot()->shootRandomConfig());
+      // Configuration of the sample projected onto each node.
+      QMap< ::hpp::ID, hpp::floatSeq_var> projected;
+
+      // Nodes come first in elements so that the edges can start from the
+      // projected configurations.
+      foreach (const Element& e, *elements) {
+        if (job->isCancelled()) return;
+        if (e.isEdge && !projected.contains(e.start)) {
+          // The edge cannot be extended from this sample.
+          ElementStat& s = (*stats)[e.id];
+          ++s.calls;
+          ++s.noStart;
+          continue;
+        }
+        bool success;
+        timer.start();
+        try {
+          if (e.isEdge) {
+            success = HPP_PLOT_CALL(
+                "graph.generateTargetConfig",
+                manip.graph()->generateTargetConfig(
+                    e.id, projected[e.start].in(), q.in(), res.out(), error));
+          } else {
+            success = HPP_PLOT_CALL("graph.applyNodeConstraints",
+                                    manip.graph()->applyNodeConstraints(
+                                        e.id, q.in(), res.out(), error));
+            if (success) projected[e.id] = res._retn();
+          }
+        } catch (const hpp::Error&) {
+          success = false;
+          error = std::numeric_limits<double>::infinity();
+        }
+        double t = (double)timer.nsecsElapsed() * 1e-6;
+
+        ElementStat& s = (*stats)[e.id];
+        ++s.calls;
+        s.totalTime += t;
+        s.maxTime = std::max(s.maxTime, t);
+        if (success)
+          ++s.success;
+        else
+          s.errors.append(error);
+      }
+    }
+  } catch (const CORBA::Exception& e) {
+    job->message(QString("%1 : %2").arg(e._name()).arg(e._rep_id()));
+    job->cancel();
+  }
+}
+
+QMap< ::hpp::ID, double> GraphProfiler::successRates() const {
+  QMap< ::hpp::ID, double> rates;
+  for (Stats_t::const_iterator it = stats_.constBegin();
+       it != stats_.constEnd(); ++it)
+    if (it->calls > 0) rates[it.key()] = it->successRate();
+  return rates;
+}
+
+QWidget* GraphProfiler::resultTable() const {
+  QTableWidget* table = new QTableWidget(stats_.size(), 9);
+  table->setHorizontalHeaderLabels(QStringList() << "Element"
+                                                 << "Id"
+                                                 << "Calls"
+                                                 << "Success rate"
+                                                 << "No initial config"
+                                                 << "Median error"
+                                                 << "Max error"
+                                                 << "Mean time (ms)"
+                                                 << "Max time (ms)");
+  table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  int row = 0;
+  foreach (const ElementStat& s, stats_) {
+    QString type = s.isEdge ? "Edge" : "Node";
+    table->setItem(row, 0, new QTableWidgetItem(type + " " + s.name));
+    table->setItem(row, 1, new NumericItem((qint64)s.id));
+    table->setItem(row, 2, new NumericItem((qint64)s.calls));
+    table->setItem(row, 3, new NumericItem(s.successRate()));
+    table->setItem(row, 4, new NumericItem((qint64)s.noStart));
+    table->setItem(row, 5, new NumericItem(s.errorQuantile(.5)));
+    table->setItem(row, 6, new NumericItem(s.errorQuantile(1.)));
+    // Only the calls made to the server were timed.
+    int timed = s.calls - s.noStart;
+    table->setItem(row, 7,
+                   new NumericItem(timed > 0 ? s.totalTime / timed : 0));
+    table->setItem(row, 8, new NumericItem(s.maxTime));
+    ++row;
+  }
+  table->setSortingEnabled(true);
+  table->sortByColumn(3, Qt::AscendingOrder);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+  table->horizontalHeader()->setSectionResizeMode(
+      QHeaderView::ResizeToContents);
+#endif
+  table->setWindowTitle("Constraint graph profile");
+  table->resize(800, 600);
+  return table;
+}
+}  // namespace plot
+}  // namespace hpp
@@ -0,0 +1,110 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HPP_PLOT_GRAPHPROFILER_HH
+#define HPP_PLOT_GRAPHPROFILER_HH
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <hpp/corbaserver/manipulation/client.hh>
+
+class QWidget;
+
+namespace hpp {
+namespace plot {
+class Job;
+
+/// Measures how hard each node and edge of the constraint graph is.
+///
+/// Random configurations are sampled. Each of them is projected onto
+/// every node and, when the projection onto its initial node succeeds,
+/// extended along every edge. Otherwise, the extension counts as failed.
+/// The work is spread over several clients connected to the same server.
+class GraphProfiler {
+ public:
+  struct ElementStat {
+    ::hpp::ID id;
+    QString name;
+    bool isEdge;
+    int calls, success;
+    /// Failed calls of an edge whose initial node could not be projected
+    /// onto. The edge was not extended.
+    int noStart;
+    /// In milliseconds.
+    double totalTime, maxTime;
+    /// Residual errors of the failed calls.
+    QVector<double> errors;
+
+    ElementStat();
+    double successRate() const;
+    /// \param q in [0, 1]
+    double errorQuantile(double q) const;
+    void merge(const ElementStat& other);
+  };
+  typedef QMap< ::hpp::ID, ElementStat> Stats_t;
+
+  GraphProfiler(const QByteArray& iiop, const QByteArray& context);
+
+  /// Run the profiler. Meant to be the work function of a Job.
+  /// \param nbSamples number of random configurations
+  /// \param nbClients number of parallel clients.
+  /// \return false if the profiling was cancelled.
+  bool run(int nbSamples, int nbClients, Job& job);
+
+  const Stats_t& stats() const { return stats_; }
+
+  /// Success rate of every profiled element.
+  QMap< ::hpp::ID, double> successRates() const;
+
+  /// Create a table of the results, the hardest elements first.
+  QWidget* resultTable() const;
+
+ private:
+  struct Element {
+    ::hpp::ID id, start;
+    QString name;
+    bool isEdge;
+  };
+
+  void worker(QVector<Element> const* elements, int nbSamples, Job* job,
+              Stats_t* stats);
+
+  QByteArray iiop_, context_;
+  QAtomicInt nextSample_;
+  Stats_t stats_;
+};
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_GRAPHPROFILER_HH
@@ -31,46 +31,175 @@
 
 #include "hppmonitoringplugin.hh"
 
+#include <QAction>
+#include <QDialog>
+#include <QDir>
 #include <QDockWidget>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QHBoxLayout>
+#include <QLabel>
+#include <QMutex>
+#include <QPointer>
+#include <QPushButton>
+#include <QSemaphore>
+#include <QThread>
 #include <QtGlobal>
 #include <limits>
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QStandardPaths>
 #include <QtConcurrent>
 #else
+#include <QDesktopServices>
 #include <QtCore>
 #endif
 
 #include <gepetto/gui/mainwindow.hh>
+#include <hpp/plot/call-stats-widget.hh>
+#include <hpp/plot/call-stats.hh>
+#include <hpp/plot/circuit-breaker.hh>
+
+#include "graphprofiler.hh"
 
 using gepetto::gui::MainWindow;
 
 namespace hpp {
 namespace plot {
+/// File of the snapshot of the constraint graph. Empty to disable it.
+static QString getSnapshotPath() {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+  QString dir =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+  QString dir =
+      QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+  return MainWindow::instance()
+      ->settings_
+      ->getSetting("hpp/graph/snapshot", dir + "/constraint-graph.snapshot")
+      .toString();
+}
+
 HppMonitoringPlugin::HppMonitoringPlugin()
-    : cgWidget_(NULL), manip_(NULL), basic_(NULL), hppPlugin_(NULL) {}
+    : cgWidget_(NULL),
+      jobs_(NULL),
+      manip_(NULL),
+      basic_(NULL),
+      connecting_(NULL),
+      retryTimer_(NULL),
+      instanceConnecting_(NULL),
+      instanceRetryTimer_(NULL),
+      wantConnection_(false),
+      swapPending_(false),
+      retryDelay_(1000),
+      initialRetryDelay_(1000),
+      maxRetryDelay_(30000),
+      instanceRetryDelay_(1000),
+      callTimeout_(5000),
+      hppPlugin_(NULL) {}
 
 HppMonitoringPlugin::~HppMonitoringPlugin() {
+  // Jobs may still use the connection and the widgets.
+  delete jobs_;
+  jobs_ = NULL;
   MainWindow* main = MainWindow::instance();
+  // Shown at once at the next start.
+  QString snapshot = getSnapshotPath();
+  if (cgWidget_ && !snapshot.isEmpty() &&
+      QDir().mkpath(QFileInfo(snapshot).absolutePath()))
+    cgWidget_->saveSnapshot(snapshot);
   foreach (QDockWidget* dock, docks_) {
     main->removeDockWidget(dock);
     delete dock;
   }
   docks_.clear();
+  cgWidget_ = NULL;
   closeConnection();
+  if (connecting_ && connecting_->isRunning()) {
+    // The attempt cannot be interrupted. Wait for it and drop its clients.
+    connecting_->waitForFinished();
+    connectionDone();
+  }
+  if (instanceConnecting_ && instanceConnecting_->isRunning()) {
+    instanceConnecting_->waitForFinished();
+    instancesConnected();
+  }
 }
 
 void HppMonitoringPlugin::init() {
+  MainWindow* main = MainWindow::instance();
+  auto* settings = main->settings_;
+  jobs_ = new JobQueue(settings->getSetting("hpp/jobs/maxThreads", 2).toInt(),
+                       this);
+  connect(jobs_, SIGNAL(idle()), SLOT(swapClients()));
+
+  // The widgets call the server from the interface thread: a server that
+  // does not answer must not freeze it. The jobs set their own deadline.
+  // Only the references of this plugin get this timeout: the other plugins
+  // make long calls, like solve.
+  callTimeout_ =
+      (CORBA::ULong)settings->getSetting("hpp/corba/callTimeout", 5000)
+          .toInt();
+  CircuitBreaker& breaker = CircuitBreaker::instance();
+  breaker.setThreshold(
+      settings->getSetting("hpp/corba/failureThreshold", 3).toInt());
+  initialRetryDelay_ =
+      qMax<qint64>(1, settings->getSetting("hpp/corba/retryDelay", 1000)
+                          .toLongLong());
+  maxRetryDelay_ = qMax(
+      initialRetryDelay_,
+      settings->getSetting("hpp/corba/maxRetryDelay", 30000).toLongLong());
+  retryDelay_ = initialRetryDelay_;
+  breaker.setCooldown(initialRetryDelay_, maxRetryDelay_);
+  connect(&breaker, SIGNAL(reachableChanged(bool)),
+          SLOT(serverReachable(bool)), Qt::QueuedConnection);
+
+  connecting_ = new QFutureWatcher<Connection>(this);
+  connect(connecting_, SIGNAL(finished()), SLOT(connectionDone()));
+  retryTimer_ = new QTimer(this);
+  retryTimer_->setSingleShot(true);
+  connect(retryTimer_, SIGNAL(timeout()), SLOT(startConnecting()));
+  instanceConnecting_ = new QFutureWatcher<Connection>(this);
+  connect(instanceConnecting_, SIGNAL(finished()),
+          SLOT(instancesConnected()));
+  instanceRetryTimer_ = new QTimer(this);
+  instanceRetryTimer_->setSingleShot(true);
+  connect(instanceRetryTimer_, SIGNAL(timeout()),
+          SLOT(startConnectingInstances()));
+
   openConnection();
 
-  MainWindow* main = MainWindow::instance();
   QDockWidget* dock;
 
+  // Job list widget
+  dock = new QDockWidget("Constraint graph &jobs", main);
+  dock->setObjectName("hppmonitoringplugin.jobs");
+  dock->setWidget(new JobListWidget(jobs_, dock));
+  main->insertDockWidget(dock, Qt::RightDockWidgetArea, Qt::Vertical);
+  docks_.append(dock);
+
+  // Server call statistics
+  dock = new QDockWidget("Constraint graph &calls", main);
+  dock->setObjectName("hppmonitoringplugin.calls");
+  dock->setWidget(new CallStatsWidget(dock));
+  main->insertDockWidget(dock, Qt::RightDockWidgetArea, Qt::Vertical);
+  docks_.append(dock);
+
   // Constraint graph widget
   dock = new QDockWidget("Constraint &Graph", main);
   dock->setObjectName("hppmonitoringplugin.constraintgraph");
   cgWidget_ = new hpp::plot::HppManipulationGraphWidget(manip_, main);
+  cgWidget_->setTuningBounds(
+      settings->getSetting("hpp/tuning/minWeight", 1).toInt(),
+      settings->getSetting("hpp/tuning/maxWeight", 100).toInt());
+  cgWidget_->setTuningMinObservations(
+      settings->getSetting("hpp/tuning/minObservations", 20).toInt());
+  cgWidget_->setTuningInterval(
+      settings->getSetting("hpp/tuning/interval", 30000).toInt());
   dock->setWidget(cgWidget_);
+  // Until connected, show the graph of the previous session.
+  QString snapshot = getSnapshotPath();
+  if (!snapshot.isEmpty()) cgWidget_->loadSnapshot(snapshot);
   main->insertDockWidget(dock, Qt::RightDockWidgetArea, Qt::Horizontal);
   dock->toggleViewAction()->setShortcut(gepetto::gui::DockKeyShortcutBase +
                                         Qt::Key_G);
@@ -146,6 +275,13 @@ void HppMonitoringPlugin::init() {
   // cgWidget_->addAction(a);
   // main->registerShortcut(dock->windowTitle(), a);
 
+  QAction* profile = new QAction("&Profile", cgWidget_);
+  profile->setToolTip(
+      "Measure the success rate of every node and edge on random "
+      "configurations");
+  connect(profile, SIGNAL(triggered()), SLOT(profileGraph()));
+  cgWidget_->addButton(profile);
+
   connect(main, SIGNAL(refresh()), cgWidget_, SLOT(updateGraph()));
   connect(main, SIGNAL(applyCurrentConfiguration()),
           SLOT(applyCurrentConfiguration()));
@@ -180,42 +316,290 @@ static QString getHppContext() {
   return context;
 }
 
-void HppMonitoringPlugin::openConnection() {
-  closeConnection();
-  basic_ = new hpp::corbaServer::Client(0, 0);
-  manip_ = new hpp::corbaServer::manipulation::Client(0, 0);
-  QByteArray iiop = getHppIIOPurl().toLatin1();
-  QByteArray context = getHppContext().toLatin1();
+/// Other servers solving the same problem, from hpp/instances: a comma
+/// separated list of ports, on the host of the main server, or of
+/// host:port.
+static QList<QByteArray> getHppInstances() {
+  QString host = gepetto::gui::MainWindow::instance()
+                     ->settings_->getSetting("hpp/host", QString("localhost"))
+                     .toString();
+  QByteArray env = qgetenv("HPP_HOST");
+  if (!env.isNull()) host = env;
+  QString list = gepetto::gui::MainWindow::instance()
+                     ->settings_->getSetting("hpp/instances", QString())
+                     .toString();
+  QList<QByteArray> urls;
+  foreach (QString instance, list.split(',', QString::SkipEmptyParts)) {
+    instance = instance.trimmed();
+    if (!instance.contains(':')) instance = host + ':' + instance;
+    urls.append(("corbaloc:iiop:" + instance).toLatin1());
+  }
+  return urls;
+}
+
+struct HppMonitoringPlugin::Connection {
+  hpp::corbaServer::Client* basic;
+  hpp::corbaServer::manipulation::Client* manip;
+  /// The other servers that answered and their urls.
+  QList<hpp::corbaServer::manipulation::Client*> instances;
+  QList<QByteArray> instanceUrls;
+  /// The urls of the other servers that did not answer.
+  QList<QByteArray> failedInstances;
+  /// Empty on success.
+  QString error;
+  /// Errors of the other servers.
+  QStringList instanceErrors;
+};
+
+/// Set the timeout of the calls made through the references of a client.
+static void setCallTimeout(hpp::corbaServer::Client* client,
+                           CORBA::ULong timeout) {
+  omniORB::setClientCallTimeout(client->robot().in(), timeout);
+  omniORB::setClientCallTimeout(client->problem().in(), timeout);
+}
+
+static void setCallTimeout(hpp::corbaServer::manipulation::Client* client,
+                           CORBA::ULong timeout) {
+  omniORB::setClientCallTimeout(client->graph().in(), timeout);
+  omniORB::setClientCallTimeout(client->problem().in(), timeout);
+}
+
+HppMonitoringPlugin::Connection HppMonitoringPlugin::connectToServer(
+    QByteArray iiop, QByteArray context, QList<QByteArray> instances,
+    CORBA::ULong timeout) {
+  Connection c;
+  c.basic = new hpp::corbaServer::Client(0, 0);
+  c.manip = new hpp::corbaServer::manipulation::Client(0, 0);
   try {
-    basic_->connect(iiop.constData(), context.constData());
-    manip_->connect(iiop.constData(), context.constData());
-    hpp::Names_t_var for_deletion = manip_->problem()->getAvailable("type");
+    c.basic->connect(iiop.constData(), context.constData());
+    c.manip->connect(iiop.constData(), context.constData());
+    setCallTimeout(c.basic, timeout);
+    setCallTimeout(c.manip, timeout);
+    // The CircuitBreaker is bypassed: it may still be open because of the
+    // previous server.
+    hpp::Names_t_var for_deletion =
+        recordedCall(HPP_PLOT_METHOD("problem.getAvailable"), [&]() {
+          return c.manip->problem()->getAvailable("type");
+        });
   } catch (const CORBA::Exception& e) {
-    QString error("Could not find the manipulation server. Is it running ?");
-    error += "\n";
-    error += e._name();
-    error += " : ";
-    error += e._rep_id();
+    c.error = QString("%1 : %2").arg(e._name()).arg(e._rep_id());
+    delete c.basic;
+    delete c.manip;
+    c.basic = NULL;
+    c.manip = NULL;
+    return c;
+  }
+  Connection others = connectInstances(context, instances, timeout);
+  c.instances = others.instances;
+  c.instanceUrls = others.instanceUrls;
+  c.failedInstances = others.failedInstances;
+  c.instanceErrors = others.instanceErrors;
+  return c;
+}
 
-    gepetto::gui::MainWindow* main = gepetto::gui::MainWindow::instance();
-    if (main != NULL)
-      main->logError(error);
-    else
-      qDebug() << error;
+HppMonitoringPlugin::Connection HppMonitoringPlugin::connectInstances(
+    QByteArray context, QList<QByteArray> urls, CORBA::ULong timeout) {
+  Connection c;
+  c.basic = NULL;
+  c.manip = NULL;
+  foreach (const QByteArray& url, urls) {
+    hpp::corbaServer::manipulation::Client* manip =
+        new hpp::corbaServer::manipulation::Client(0, 0);
+    try {
+      manip->connect(url.constData(), context.constData());
+      setCallTimeout(manip, timeout);
+      hpp::Names_t_var for_deletion =
+          recordedCall(HPP_PLOT_METHOD("problem.getAvailable"), [&]() {
+            return manip->problem()->getAvailable("type");
+          });
+      c.instances.append(manip);
+      c.instanceUrls.append(url);
+    } catch (const CORBA::Exception& e) {
+      c.failedInstances.append(url);
+      c.instanceErrors.append(
+          QString("%1: %2 : %3").arg(url.constData()).arg(e._name()).arg(
+              e._rep_id()));
+      delete manip;
+    }
+  }
+  return c;
+}
+
+void HppMonitoringPlugin::openConnection() {
+  retryTimer_->stop();
+  retryDelay_ = initialRetryDelay_;
+  wantConnection_ = true;
+  startConnecting();
+}
+
+void HppMonitoringPlugin::startConnecting() {
+  if (!wantConnection_ || connecting_->isRunning() || swapPending_) return;
+  connecting_->setFuture(QtConcurrent::run(
+      connectToServer, getHppIIOPurl().toLatin1(),
+      getHppContext().toLatin1(), getHppInstances(), callTimeout_));
+}
+
+void HppMonitoringPlugin::connectionDone() {
+  Connection c = connecting_->result();
+  if (!wantConnection_) {
+    delete c.basic;
+    delete c.manip;
+    qDeleteAll(c.instances);
+    return;
+  }
+  MainWindow* main = MainWindow::instance();
+  if (!c.error.isEmpty()) {
+    // Only report the first failure of a series.
+    if (retryDelay_ == initialRetryDelay_) {
+      QString error(
+          "Could not find the manipulation server. Is it running ? "
+          "Retrying in the background.\n");
+      error += c.error;
+      if (main != NULL)
+        main->logError(error);
+      else
+        qDebug() << error;
+    }
+    retryTimer_->start((int)retryDelay_);
+    retryDelay_ = qMin(2 * retryDelay_, maxRetryDelay_);
+    return;
+  }
+
+  // Swap the clients once no job uses the previous ones. The result stays
+  // in connecting_ meanwhile.
+  swapPending_ = true;
+  if (jobs_ && !jobs_->isIdle())
+    jobs_->cancelAll();
+  else
+    swapClients();
+}
 
-    closeConnection();
+void HppMonitoringPlugin::swapClients() {
+  if (!swapPending_) return;
+  swapPending_ = false;
+  Connection c = connecting_->result();
+  if (!wantConnection_) {
+    delete c.basic;
+    delete c.manip;
+    qDeleteAll(c.instances);
     return;
   }
+  MainWindow* main = MainWindow::instance();
+  // cgWidget_ owns the clients of the other servers.
+  if (cgWidget_)
+    cgWidget_->setInstances(c.instances);
+  else
+    qDeleteAll(c.instances);
+  // cgWidget_ may use the previous clients until it gets the new one.
+  hpp::corbaServer::Client* oldBasic = basic_;
+  hpp::corbaServer::manipulation::Client* oldManip = manip_;
+  basic_ = c.basic;
+  manip_ = c.manip;
+  retryDelay_ = initialRetryDelay_;
+  CircuitBreaker& breaker = CircuitBreaker::instance();
+  breaker.reset();
+  // While the server is unreachable, it is probed in the background with
+  // clients of its own, which the interface never waits for.
+  QByteArray iiop = getHppIIOPurl().toLatin1();
+  QByteArray context = getHppContext().toLatin1();
+  CORBA::ULong timeout = callTimeout_;
+  breaker.setProbe([iiop, context, timeout]() {
+    hpp::corbaServer::manipulation::Client probe(0, 0);
+    probe.connect(iiop.constData(), context.constData());
+    setCallTimeout(&probe, timeout);
+    hpp::Names_t_var for_deletion = probe.problem()->getAvailable("type");
+  });
+  if (main != NULL) {
+    main->log(QString("Connected to the manipulation server and to %1 other "
+                      "servers.")
+                  .arg(c.instances.size()));
+    foreach (const QString& error, c.instanceErrors)
+      main->logError("Could not connect to the server " + error +
+                     ". Retrying in the background.");
+  }
+  failedInstances_ = c.failedInstances;
+  instanceRetryTimer_->stop();
+  instanceRetryDelay_ = initialRetryDelay_;
+  if (!failedInstances_.isEmpty())
+    instanceRetryTimer_->start((int)instanceRetryDelay_);
   if (cgWidget_) cgWidget_->client(manip_);
+  delete oldBasic;
+  delete oldManip;
+}
+
+void HppMonitoringPlugin::startConnectingInstances() {
+  if (!wantConnection_ || failedInstances_.isEmpty() ||
+      instanceConnecting_->isRunning())
+    return;
+  instanceConnecting_->setFuture(QtConcurrent::run(
+      connectInstances, getHppContext().toLatin1(), failedInstances_,
+      callTimeout_));
+}
+
+void HppMonitoringPlugin::instancesConnected() {
+  Connection c = instanceConnecting_->result();
+  // The servers may have been reconnected or disconnected meanwhile.
+  QList<hpp::corbaServer::manipulation::Client*> connected;
+  for (int i = 0; i < c.instances.size(); ++i) {
+    if (wantConnection_ && cgWidget_ &&
+        failedInstances_.removeOne(c.instanceUrls[i]))
+      connected.append(c.instances[i]);
+    else
+      delete c.instances[i];
+  }
+  if (!connected.isEmpty()) {
+    cgWidget_->addInstances(connected);
+    MainWindow* main = MainWindow::instance();
+    if (main != NULL)
+      main->log(QString("Connected to %1 other servers.")
+                    .arg(connected.size()));
+  }
+  if (!wantConnection_ || failedInstances_.isEmpty()) return;
+  // The errors were reported by connectionDone.
+  instanceRetryDelay_ = qMin(2 * instanceRetryDelay_, maxRetryDelay_);
+  instanceRetryTimer_->start((int)instanceRetryDelay_);
 }
 
 void HppMonitoringPlugin::closeConnection() {
+  wantConnection_ = false;
+  CircuitBreaker::instance().setProbe(CircuitBreaker::Probe());
+  if (retryTimer_) retryTimer_->stop();
+  if (instanceRetryTimer_) instanceRetryTimer_->stop();
+  failedInstances_.clear();
+  // Drop the clients that wait for the jobs.
+  swapClients();
+  if (jobs_) {
+    jobs_->cancelAll();
+    jobs_->waitForDone();
+  }
+  if (cgWidget_) {
+    cgWidget_->setInstances(QList<hpp::corbaServer::manipulation::Client*>());
+    cgWidget_->client(NULL);
+  }
   if (basic_) delete basic_;
   basic_ = NULL;
   if (manip_) delete manip_;
   manip_ = NULL;
 }
 
+void HppMonitoringPlugin::serverReachable(bool reachable) {
+  // The server may have been restarted, with new object references.
+  if (reachable) {
+    retryTimer_->stop();
+    retryDelay_ = initialRetryDelay_;
+  } else if (wantConnection_ && !connecting_->isRunning()) {
+    retryTimer_->start((int)retryDelay_);
+  }
+  MainWindow* main = MainWindow::instance();
+  if (main == NULL) return;
+  if (reachable)
+    main->log("The manipulation server answers again.");
+  else
+    main->logError(
+        "The manipulation server is unreachable. The calls to the server "
+        "fail at once until it answers again.");
+}
+
 bool HppMonitoringPlugin::corbaException(int jobId,
                                          const CORBA::Exception& excep) const {
   try {
@@ -228,52 +612,167 @@ bool HppMonitoringPlugin::corbaException(int jobId,
   return false;
 }
 
+/// Shared state of the workers of a parallel random projection.
+struct HppMonitoringPlugin::RandomProjection {
+  hpp::ID idNode;
+  int maxTrials, nbWorkers;
+  qint64 maxTime;  // in milliseconds, <= 0 means unlimited.
+  /// Deadline of the job from the start of timer, in milliseconds. < 0
+  /// means none.
+  qint64 deadline;
+  QElapsedTimer timer;
+
+  /// Number of trials reserved by the workers.
+  QAtomicInt reserved;
+  /// Number of trials done.
+  QAtomicInt trials;
+  /// Set on success, on error or when the user cancels.
+  QAtomicInt stop;
+  /// Released once by each worker when it returns.
+  QSemaphore finished;
+
+  QMutex mutex;
+  bool success;
+  ::CORBA::Double minError;
+  hpp::floatSeq best;
+  QString error;
+
+  RandomProjection(hpp::ID id)
+      : idNode(id),
+        maxTrials(20),
+        nbWorkers(1),
+        maxTime(0),
+        deadline(-1),
+        reserved(0),
+        trials(0),
+        stop(0),
+        success(false),
+        minError(std::numeric_limits<double>::infinity()) {}
+};
+
 void HppMonitoringPlugin::projectRandomConfigOn(hpp::ID idNode) {
-  QFutureWatcher<bool>* fw = new QFutureWatcher<bool>(this);
+  if (manip_ == NULL) return;
+  QSharedPointer<RandomProjection> rp(new RandomProjection(idNode));
+  auto* settings = MainWindow::instance()->settings_;
+  rp->maxTrials =
+      settings->getSetting("hpp/projection/maxTrials", 20).toInt();
+  rp->maxTime =
+      settings->getSetting("hpp/projection/maxTime", 0).toLongLong();
+  rp->nbWorkers =
+      settings
+          ->getSetting("hpp/projection/nbWorkers",
+                       qMax(1, QThread::idealThreadCount()))
+          .toInt();
+  rp->nbWorkers = qBound(1, rp->nbWorkers, qMax(1, rp->maxTrials));
+
   QDialog* d = new QDialog(NULL, Qt::Dialog);
   QLabel* l = new QLabel("Projecting...");
+  QPushButton* cancel = new QPushButton("&Stop");
   d->setLayout(new QHBoxLayout);
   d->layout()->addWidget(l);
+  d->layout()->addWidget(cancel);
   connect(this, SIGNAL(projectionStatus(QString)), l, SLOT(setText(QString)));
+  QPointer<QDialog> dialog(d);
+
+  JobPtr_t job = jobs_->submit(
+      QString("Generate config on node %1").arg(idNode),
+      [this, rp](Job& job) { return projectRandomConfigOn_impl(rp, job); },
+      [this, rp, dialog](Job&) {
+        if (dialog) dialog->deleteLater();
+        if (!rp->error.isEmpty()) MainWindow::instance()->logError(rp->error);
+        if (rp->best.length() == 0) return;
+        setCurrentConfig(rp->best);
+        if (!rp->success)
+          MainWindow::instance()->logError(
+              QString("Projection failed after %1 trials. Using the "
+                      "configuration with the minimal residual error %2")
+                  .arg(rp->trials.loadAcquire())
+                  .arg(rp->minError));
+      },
+      jobTimeout());
+  int id = job->id();
+  connect(cancel, &QPushButton::clicked, [this, id]() { jobs_->cancel(id); });
   d->show();
-  fw->setFuture(QtConcurrent::run(
-      this, &HppMonitoringPlugin::projectRandomConfigOn_impl, idNode));
-  connect(fw, SIGNAL(finished()), d, SLOT(deleteLater()));
-  connect(fw, SIGNAL(finished()), fw, SLOT(deleteLater()));
 }
 
-bool HppMonitoringPlugin::projectRandomConfigOn_impl(hpp::ID idNode) {
-  if (manip_ == NULL) return false;
+bool HppMonitoringPlugin::projectRandomConfigOn_impl(
+    QSharedPointer<RandomProjection> rp, Job& job) {
+  rp->timer.start();
+  rp->deadline = job.remaining();
+  // The workers run on the global pool. This thread only reports the
+  // progress until all of them are done.
+  for (int i = 0; i < rp->nbWorkers; ++i)
+    QtConcurrent::run(this, &HppMonitoringPlugin::randomProjectionWorker,
+                      rp.data());
+  while (!rp->finished.tryAcquire(rp->nbWorkers, 200)) {
+    if (job.isCancelled()) rp->stop.storeRelease(1);
+    qint64 elapsed = qMax<qint64>(1, rp->timer.elapsed());
+    int trials = rp->trials.loadAcquire();
+    ::CORBA::Double minError;
+    {
+      QMutexLocker lock(&rp->mutex);
+      minError = rp->minError;
+    }
+    QString status =
+        QString("Tried %1 times (%2 per second). Minimal residual error is %3")
+            .arg(trials)
+            .arg(1000. * trials / elapsed, 0, 'f', 1)
+            .arg(minError);
+    job.message(status);
+    emit projectionStatus(status);
+  }
+  job.message(QString("%1 trials. Minimal residual error is %2")
+                  .arg(rp->trials.loadAcquire())
+                  .arg(rp->minError));
+  return rp->success;
+}
+
+void HppMonitoringPlugin::randomProjectionWorker(RandomProjection* rp) {
   hpp::floatSeq_var qRand;
   hpp::floatSeq_var res;
-  ::CORBA::Double error, minError = std::numeric_limits<double>::infinity();
-  int i = 0;
+  ::CORBA::Double error;
+  // The deadline of the job also applies to each server call made by this
+  // thread, as in Job::run.
+  if (rp->deadline >= 0)
+    omniORB::setClientThreadCallTimeout((CORBA::ULong)qMax<qint64>(
+        1, rp->deadline - rp->timer.elapsed()));
   try {
-    do {
-      qRand = basic_->robot()->shootRandomConfig();
-      i++;
-      bool success = manip_->graph()->applyNodeConstraints(idNode, qRand.in(),
-                                                           res.out(), error);
+    while (rp->stop.loadAcquire() == 0) {
+      if (rp->reserved.fetchAndAddOrdered(1) >= rp->maxTrials) break;
+      if (rp->maxTime > 0 && rp->timer.elapsed() > rp->maxTime) break;
+      qRand = HPP_PLOT_CALL("robot.shootRandomConfig",
+                            basic_->robot()->shootRandomConfig());
+      bool success = HPP_PLOT_CALL(
+          "graph.applyNodeConstraints",
+          manip_->graph()->applyNodeConstraints(rp->idNode, qRand.in(),
+                                                res.out(), error));
+      rp->trials.fetchAndAddOrdered(1);
+
+      QMutexLocker lock(&rp->mutex);
+      if (rp->success) break;
       if (success) {
-        setCurrentConfig(res.in());
-        return true;
-      }
-      if (error < minError) {
-        minError = error;
-      }
-      if (i >= 20) {
-        qDebug() << "Projection failed after 20 trials.";
+        rp->success = true;
+        rp->minError = error;
+        rp->best = res.in();
+        rp->stop.storeRelease(1);
         break;
       }
-      emit projectionStatus(
-          QString("Tried %1 times. Minimal residual error is %2")
-              .arg(i)
-              .arg(minError));
-    } while (true);
+      if (error < rp->minError) {
+        rp->minError = error;
+        rp->best = res.in();
+      }
+    }
   } catch (const hpp::Error& e) {
-    MainWindow::instance()->logError(e.msg.in());
+    QMutexLocker lock(&rp->mutex);
+    rp->error = e.msg.in();
+    rp->stop.storeRelease(1);
+  } catch (const CORBA::Exception& e) {
+    QMutexLocker lock(&rp->mutex);
+    rp->error = QString("%1 : %2").arg(e._name()).arg(e._rep_id());
+    rp->stop.storeRelease(1);
   }
-  return false;
+  if (rp->deadline >= 0) omniORB::setClientThreadCallTimeout(0);
+  rp->finished.release();
 }
 
 bool HppMonitoringPlugin::projectCurrentConfigOn(ID idNode) {
@@ -283,52 +782,118 @@ bool HppMonitoringPlugin::projectCurrentConfigOn(ID idNode) {
 
 void HppMonitoringPlugin::setTargetState(ID idNode) {
   if (manip_ == NULL) return;
-  manip_->problem()->setTargetState(idNode);
+  jobs_->submit(QString("Set target state %1").arg(idNode),
+                [this, idNode](Job&) {
+                  HPP_PLOT_CALL("problem.setTargetState",
+                                manip_->problem()->setTargetState(idNode));
+                  return true;
+                },
+                Job::Done(), jobTimeout());
 }
 
 bool HppMonitoringPlugin::extendFromCurrentToCurrentConfigOn(hpp::ID idEdge) {
   hpp::floatSeq from = getCurrentConfig();
-  return extendConfigOn(from, from, idEdge);
+  return extendConfigOn(from, from, idEdge, false);
 }
 
 bool HppMonitoringPlugin::extendFromCurrentToRandomConfigOn(hpp::ID idEdge) {
   hpp::floatSeq from = getCurrentConfig();
-  hpp::floatSeq_var qRand = basic_->robot()->shootRandomConfig();
-  return extendConfigOn(from, qRand.in(), idEdge);
+  return extendConfigOn(from, from, idEdge, true);
 }
 
-bool HppMonitoringPlugin::projectConfigOn(hpp::floatSeq config,
-                                          hpp::ID idNode) {
-  if (manip_ == NULL) return false;
-  hpp::floatSeq_var res;
+/// Result of a projection made by a job.
+struct HppMonitoringPlugin::ProjectionResult {
+  hpp::floatSeq_var q;
   ::CORBA::Double error;
-  bool success =
-      manip_->graph()->applyNodeConstraints(idNode, config, res.out(), error);
-  if (success) {
-    setCurrentConfig(res.in());
-  } else {
+  bool computed, success;
+  ProjectionResult() : error(0), computed(false), success(false) {}
+};
+
+void HppMonitoringPlugin::applyProjectionResult(const ProjectionResult& r) {
+  if (r.success) {
+    setCurrentConfig(r.q.in());
+  } else if (r.computed) {
     MainWindow::instance()->logError(
         QString("Unable to project configuration. Residual error is %1")
-            .arg(error));
+            .arg(r.error));
   }
-  return success;
+}
+
+bool HppMonitoringPlugin::projectConfigOn(hpp::floatSeq config,
+                                          hpp::ID idNode) {
+  if (manip_ == NULL) return false;
+  QSharedPointer<ProjectionResult> r(new ProjectionResult);
+  jobs_->submit(QString("Project current config on node %1").arg(idNode),
+                [this, r, config, idNode](Job&) {
+                  r->success = HPP_PLOT_CALL(
+                      "graph.applyNodeConstraints",
+                      manip_->graph()->applyNodeConstraints(
+                          idNode, config, r->q.out(), r->error));
+                  r->computed = true;
+                  return r->success;
+                },
+                [this, r](Job&) { applyProjectionResult(*r); }, jobTimeout());
+  return true;
 }
 
 bool HppMonitoringPlugin::extendConfigOn(hpp::floatSeq from,
-                                         hpp::floatSeq config, hpp::ID idEdge) {
+                                         hpp::floatSeq config, hpp::ID idEdge,
+                                         bool shootConfig) {
   if (manip_ == NULL) return false;
-  hpp::floatSeq_var res;
-  ::CORBA::Double error;
-  bool success = manip_->graph()->generateTargetConfig(idEdge, from, config,
-                                                       res.out(), error);
-  if (success) {
-    setCurrentConfig(res.in());
-  } else {
-    MainWindow::instance()->logError(
-        QString("Unable to project configuration. Residual error is %1")
-            .arg(error));
-  }
-  return success;
+  QSharedPointer<ProjectionResult> r(new ProjectionResult);
+  jobs_->submit(
+      QString("Extend current config along edge %1").arg(idEdge),
+      [this, r, from, config, idEdge, shootConfig](Job& job) {
+        hpp::floatSeq_var qRand;
+        if (shootConfig)
+          qRand = HPP_PLOT_CALL("robot.shootRandomConfig",
+                                basic_->robot()->shootRandomConfig());
+        else
+          qRand = new hpp::floatSeq(config);
+        if (job.isCancelled()) return false;
+        r->success = HPP_PLOT_CALL(
+            "graph.generateTargetConfig",
+            manip_->graph()->generateTargetConfig(idEdge, from, qRand.in(),
+                                                  r->q.out(), r->error));
+        r->computed = true;
+        return r->success;
+      },
+      [this, r](Job&) { applyProjectionResult(*r); }, jobTimeout());
+  return true;
+}
+
+void HppMonitoringPlugin::profileGraph() {
+  if (manip_ == NULL) return;
+  auto* settings = MainWindow::instance()->settings_;
+  int nbSamples = settings->getSetting("hpp/profiler/nbSamples", 20).toInt();
+  int nbClients = settings
+                      ->getSetting("hpp/profiler/nbClients",
+                                   qMax(1, QThread::idealThreadCount()))
+                      .toInt();
+  QSharedPointer<GraphProfiler> profiler(new GraphProfiler(
+      getHppIIOPurl().toLatin1(), getHppContext().toLatin1()));
+  jobs_->submit(
+      "Profile constraint graph",
+      [profiler, nbSamples, nbClients](Job& job) {
+        return profiler->run(nbSamples, nbClients, job);
+      },
+      [this, profiler](Job& job) {
+        if (job.state() != Job::Succeeded) return;
+        cgWidget_->showSuccessRates(profiler->successRates());
+        QWidget* table = profiler->resultTable();
+        table->setAttribute(Qt::WA_DeleteOnClose);
+        // The rates color the graph while the table is open.
+        connect(table, SIGNAL(destroyed()), cgWidget_,
+                SLOT(hideSuccessRates()));
+        table->show();
+      },
+      0, JobQueue::Background);
+}
+
+qint64 HppMonitoringPlugin::jobTimeout() const {
+  return MainWindow::instance()
+      ->settings_->getSetting("hpp/jobs/timeout", 0)
+      .toLongLong();
 }
 
 void HppMonitoringPlugin::applyCurrentConfiguration() {
@@ -341,7 +906,9 @@ void HppMonitoringPlugin::appliedConfigAtParam(int pid, double param) {
   CORBA::String_var graphName;
   hpp::ID id;
   try {
-    id = manip_->problem()->edgeAtParam(pid, param, graphName.out());
+    id = HPP_PLOT_CALL(
+        "problem.edgeAtParam",
+        manip_->problem()->edgeAtParam(pid, param, graphName.out()));
   } catch (const hpp::Error& e) {
     return;
   }
@@ -32,6 +32,9 @@
 #ifndef HPP_PLOT_HPPWIDGETSPLUGIN_HH
 #define HPP_PLOT_HPPWIDGETSPLUGIN_HH
 
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QTimer>
 #include <gepetto/gui/plugin-interface.hh>
 #include <hpp/corbaserver/manipulation/client.hh>
 #include <hpp/plot/hpp-manipulation-graph.hh>
@@ -39,6 +42,8 @@
 #undef __problem_hh__
 #include <hpp/corbaserver/client.hh>
 
+#include "jobqueue.hh"
+
 class QDockWidget;
 
 namespace hpp {
@@ -64,6 +69,8 @@ class HppMonitoringPlugin : public QObject,
 
   // CorbaInterface
  public:
+  /// Connect in the background, retrying with an exponential backoff until
+  /// the server answers. The clients are replaced once connected.
   virtual void openConnection();
   virtual void closeConnection();
   virtual bool corbaException(int jobId, const CORBA::Exception& excep) const;
@@ -76,15 +83,63 @@ class HppMonitoringPlugin : public QObject,
   bool extendFromCurrentToRandomConfigOn(hpp::ID idEdge);
   void applyCurrentConfiguration();
   void appliedConfigAtParam(int pid, double param);
+  /// Measure the success rate of every node and edge, using random
+  /// configurations.
+  void profileGraph();
 
  signals:
   void projectionStatus(QString status);
 
+ private slots:
+  /// Log the changes of the CircuitBreaker.
+  void serverReachable(bool reachable);
+  /// Start a connection attempt, unless one is running.
+  void startConnecting();
+  /// Use the clients of the attempt or schedule the next attempt.
+  void connectionDone();
+  /// Replace the clients by those of the last attempt, once no job uses
+  /// them.
+  void swapClients();
+  /// Connect again to the other servers that failed.
+  void startConnectingInstances();
+  /// Give the other servers that answered to cgWidget_ or schedule the next
+  /// attempt.
+  void instancesConnected();
+
  private:
-  bool projectConfigOn(hpp::floatSeq config, hpp::ID idNode);
-  bool extendConfigOn(hpp::floatSeq from, hpp::floatSeq config, hpp::ID idEdge);
+  struct Connection;
+  struct ProjectionResult;
+  struct RandomProjection;
 
-  bool projectRandomConfigOn_impl(hpp::ID idNode);
+  /// Schedule the projection of config on the node.
+  /// \return false if the plugin is not connected.
+  bool projectConfigOn(hpp::floatSeq config, hpp::ID idNode);
+  /// Schedule the extension of from along the edge.
+  /// \param shootConfig whether the target is config or a random
+  ///        configuration.
+  /// \return false if the plugin is not connected.
+  bool extendConfigOn(hpp::floatSeq from, hpp::floatSeq config, hpp::ID idEdge,
+                      bool shootConfig);
+  void applyProjectionResult(const ProjectionResult& r);
+  /// Create the clients and call each server once.
+  /// Runs in a thread of the global QThreadPool.
+  /// \param timeout of the calls made through the clients, in
+  ///        milliseconds.
+  static Connection connectToServer(QByteArray iiop, QByteArray context,
+                                    QList<QByteArray> instances,
+                                    CORBA::ULong timeout);
+  /// Create the clients of the other servers and call each server once.
+  /// Runs in a thread of the global QThreadPool.
+  static Connection connectInstances(QByteArray context,
+                                     QList<QByteArray> urls,
+                                     CORBA::ULong timeout);
+
+  bool projectRandomConfigOn_impl(QSharedPointer<RandomProjection> rp,
+                                  Job& job);
+  void randomProjectionWorker(RandomProjection* rp);
+
+  /// Deadline of the jobs, in milliseconds, from the settings.
+  qint64 jobTimeout() const;
 
   hpp::floatSeq getCurrentConfig();
   void setCurrentConfig(const hpp::floatSeq& q);
@@ -92,9 +147,27 @@ class HppMonitoringPlugin : public QObject,
 
   hpp::plot::HppManipulationGraphWidget* cgWidget_;
   QList<QDockWidget*> docks_;
+  JobQueue* jobs_;
 
   hpp::corbaServer::manipulation::Client* manip_;
   hpp::corbaServer::Client* basic_;
+  QFutureWatcher<Connection>* connecting_;
+  QTimer* retryTimer_;
+  /// Other servers that did not answer, retried with the same backoff as
+  /// the main server. The clients of those that answer are given to
+  /// cgWidget_.
+  QList<QByteArray> failedInstances_;
+  QFutureWatcher<Connection>* instanceConnecting_;
+  QTimer* instanceRetryTimer_;
+  /// Whether the result of the running attempt should be used.
+  bool wantConnection_;
+  /// Whether the clients of connecting_ wait for the jobs to finish.
+  bool swapPending_;
+  /// In milliseconds.
+  qint64 retryDelay_, initialRetryDelay_, maxRetryDelay_, instanceRetryDelay_;
+  /// Timeout of the calls made through the clients of this plugin, in
+  /// milliseconds.
+  CORBA::ULong callTimeout_;
   QObject* hppPlugin_;
 };
 }  // namespace plot
@@ -0,0 +1,336 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "jobqueue.hh"
+
+#include <QAction>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTimer>
+#include <hpp/corbaserver/manipulation/client.hh>
+#include <hpp/plot/tracer.hh>
+#include <stdexcept>
+
+namespace hpp {
+namespace plot {
+Job::Job(int id, const QString& name, const Work& work, const Done& done)
+    : id_(id),
+      name_(name),
+      work_(work),
+      done_(done),
+      timeout_(0),
+      cancelled_(0),
+      state_(Queued),
+      started_(-1),
+      finished_(-1),
+      delivered_(false) {
+  created_.start();
+}
+
+Job::State Job::state() const {
+  QMutexLocker lock(&mutex_);
+  return state_;
+}
+
+QString Job::message() const {
+  QMutexLocker lock(&mutex_);
+  return message_;
+}
+
+void Job::message(const QString& msg) {
+  QMutexLocker lock(&mutex_);
+  message_ = msg;
+}
+
+qint64 Job::duration() const {
+  QMutexLocker lock(&mutex_);
+  switch (state_) {
+    case Queued:
+      return created_.elapsed();
+    case Running:
+      return created_.elapsed() - started_;
+    default:
+      return finished_ - (started_ < 0 ? finished_ : started_);
+  }
+}
+
+qint64 Job::remaining() const {
+  if (timeout_ <= 0) return -1;
+  return qMax<qint64>(0, timeout_ - created_.elapsed());
+}
+
+bool Job::isFinished() const {
+  QMutexLocker lock(&mutex_);
+  return state_ != Queued && state_ != Running;
+}
+
+QString Job::stateName(State state) {
+  switch (state) {
+    case Queued:
+      return "Queued";
+    case Running:
+      return "Running";
+    case Succeeded:
+      return "Succeeded";
+    case Failed:
+      return "Failed";
+    case Cancelled:
+      return "Cancelled";
+    case TimedOut:
+      return "Timed out";
+  }
+  return QString();
+}
+
+void Job::run() {
+  {
+    QMutexLocker lock(&mutex_);
+    if (isCancelled()) {
+      state_ = expired() ? TimedOut : Cancelled;
+      finished_ = created_.elapsed();
+      return;
+    }
+    state_ = Running;
+    started_ = created_.elapsed();
+  }
+
+  // The deadline also applies to each server call made by this thread.
+  qint64 rem = remaining();
+  if (rem > 0) omniORB::setClientThreadCallTimeout((CORBA::ULong)rem);
+
+  State state = Failed;
+  QString msg;
+  try {
+    TraceScope trace(
+        Tracer::enabled() ? Tracer::instance().intern(name_) : "", "job");
+    if (work_(*this)) state = Succeeded;
+  } catch (const hpp::Error& e) {
+    msg = e.msg.in();
+  } catch (const CORBA::TIMEOUT&) {
+    state = TimedOut;
+    msg = "Timeout";
+  } catch (const CORBA::Exception& e) {
+    msg = QString("%1 : %2").arg(e._name()).arg(e._rep_id());
+  } catch (const std::exception& e) {
+    msg = e.what();
+  }
+  if (rem > 0) omniORB::setClientThreadCallTimeout(0);
+
+  if (state == Failed && isCancelled())
+    state = expired() ? TimedOut : Cancelled;
+
+  QMutexLocker lock(&mutex_);
+  state_ = state;
+  finished_ = created_.elapsed();
+  if (!msg.isEmpty()) message_ = msg;
+}
+
+class JobQueue::Runnable : public QRunnable {
+ public:
+  Runnable(JobQueue* queue, const JobPtr_t& job) : queue_(queue), job_(job) {}
+
+  void run() {
+    job_->run();
+    QMetaObject::invokeMethod(queue_, "finish", Qt::QueuedConnection,
+                              Q_ARG(int, job_->id()));
+  }
+
+ private:
+  JobQueue* queue_;
+  JobPtr_t job_;
+};
+
+JobQueue::JobQueue(int maxThreadCount, QObject* parent)
+    : QObject(parent), nextId_(0), unfinished_(0) {
+  pool_.setMaxThreadCount(qMax(1, maxThreadCount));
+}
+
+JobQueue::~JobQueue() {
+  cancelAll();
+  waitForDone();
+}
+
+JobPtr_t JobQueue::submit(const QString& name, const Job::Work& work,
+                          const Job::Done& done, qint64 timeout,
+                          Priority priority) {
+  JobPtr_t job;
+  {
+    QMutexLocker lock(&mutex_);
+    job = JobPtr_t(new Job(nextId_++, name, work, done));
+    job->deadline(timeout);
+    jobs_.append(job);
+    ++unfinished_;
+  }
+  emit jobChanged(job->id());
+  pool_.start(new Runnable(this, job), priority);
+  return job;
+}
+
+JobPtr_t JobQueue::job(int id) const {
+  QMutexLocker lock(&mutex_);
+  foreach (const JobPtr_t& job, jobs_)
+    if (job->id() == id) return job;
+  return JobPtr_t();
+}
+
+QList<JobPtr_t> JobQueue::jobs() const {
+  QMutexLocker lock(&mutex_);
+  return jobs_;
+}
+
+void JobQueue::clearFinished(int keep) {
+  QMutexLocker lock(&mutex_);
+  int nbFinished = 0;
+  for (int i = jobs_.size() - 1; i >= 0; --i) {
+    if (!jobs_[i]->isFinished()) continue;
+    {
+      QMutexLocker jobLock(&jobs_[i]->mutex_);
+      if (!jobs_[i]->delivered_) continue;
+    }
+    if (nbFinished++ >= keep) jobs_.removeAt(i);
+  }
+}
+
+void JobQueue::waitForDone() { pool_.waitForDone(); }
+
+bool JobQueue::isIdle() const {
+  QMutexLocker lock(&mutex_);
+  return unfinished_ == 0;
+}
+
+void JobQueue::cancel(int id) {
+  JobPtr_t j = job(id);
+  if (!j) return;
+  j->cancel();
+  emit jobChanged(id);
+}
+
+void JobQueue::cancelAll() {
+  foreach (const JobPtr_t& job, jobs()) job->cancel();
+}
+
+void JobQueue::finish(int id) {
+  // clearFinished keeps the job until its done function is called.
+  JobPtr_t j = job(id);
+  if (j) {
+    if (j->done_) {
+      try {
+        j->done_(*j);
+      } catch (const std::exception& e) {
+        qDebug() << "Job" << j->name() << ":" << e.what();
+      }
+    }
+    {
+      QMutexLocker lock(&j->mutex_);
+      j->delivered_ = true;
+    }
+    emit jobChanged(id);
+    emit jobFinished(id);
+    clearFinished(100);
+  }
+  bool last;
+  {
+    QMutexLocker lock(&mutex_);
+    last = (--unfinished_ == 0);
+  }
+  if (last) emit idle();
+}
+
+JobListWidget::JobListWidget(JobQueue* queue, QWidget* parent)
+    : QTreeWidget(parent), queue_(queue), timer_(new QTimer(this)) {
+  setColumnCount(4);
+  setHeaderLabels(QStringList() << "Action"
+                                << "State"
+                                << "Duration (ms)"
+                                << "Message");
+  setRootIsDecorated(false);
+  setSelectionMode(QAbstractItemView::ExtendedSelection);
+  setContextMenuPolicy(Qt::ActionsContextMenu);
+
+  QAction* a = new QAction("&Cancel", this);
+  connect(a, SIGNAL(triggered()), SLOT(cancelSelected()));
+  addAction(a);
+  a = new QAction("C&lear finished", this);
+  connect(a, SIGNAL(triggered()), SLOT(clearFinished()));
+  addAction(a);
+
+  connect(queue_, SIGNAL(jobChanged(int)), SLOT(jobChanged(int)));
+  connect(timer_, SIGNAL(timeout()), SLOT(updateDurations()));
+  timer_->start(500);
+}
+
+void JobListWidget::cancelSelected() {
+  foreach (QTreeWidgetItem* item, selectedItems())
+    queue_->cancel(items_.key(item, -1));
+}
+
+void JobListWidget::clearFinished() {
+  queue_->clearFinished();
+  updateDurations();
+}
+
+void JobListWidget::jobChanged(int id) {
+  JobPtr_t job = queue_->job(id);
+  if (!job) return;
+  QTreeWidgetItem* item = items_.value(id, NULL);
+  if (item == NULL) {
+    item = new QTreeWidgetItem(this);
+    item->setText(0, job->name());
+    items_[id] = item;
+  }
+  updateItem(item, *job);
+}
+
+void JobListWidget::updateDurations() {
+  QMap<int, QTreeWidgetItem*>::iterator it = items_.begin();
+  while (it != items_.end()) {
+    JobPtr_t job = queue_->job(it.key());
+    if (!job) {
+      delete it.value();
+      it = items_.erase(it);
+      continue;
+    }
+    if (!job->isFinished()) updateItem(it.value(), *job);
+    ++it;
+  }
+}
+
+void JobListWidget::updateItem(QTreeWidgetItem* item, const Job& job) {
+  Job::State state = job.state();
+  QString stateStr = Job::stateName(state);
+  if (!job.isFinished() && job.isCancelled()) stateStr += " (cancelling)";
+  item->setText(1, stateStr);
+  item->setText(2, QString::number(job.duration()));
+  item->setText(3, job.message());
+}
+}  // namespace plot
+}  // namespace hpp
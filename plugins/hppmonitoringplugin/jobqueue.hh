@@ -0,0 +1,190 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef HPP_PLOT_JOBQUEUE_HH
+#define HPP_PLOT_JOBQUEUE_HH
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QTreeWidget>
+#include <functional>
+
+class QTimer;
+
+namespace hpp {
+namespace plot {
+/// An action run by a JobQueue.
+///
+/// The work function runs on a thread of the pool. It should check
+/// isCancelled() between two server calls. The done function runs in the
+/// thread of the JobQueue once the job is over, whatever its state.
+class Job {
+ public:
+  enum State { Queued, Running, Succeeded, Failed, Cancelled, TimedOut };
+
+  typedef std::function<bool(Job&)> Work;
+  typedef std::function<void(Job&)> Done;
+
+  int id() const { return id_; }
+  const QString& name() const { return name_; }
+  State state() const;
+  /// Message set by the work function or the error that stopped it.
+  QString message() const;
+  void message(const QString& msg);
+
+  /// Time spent in the queue or running, in milliseconds.
+  qint64 duration() const;
+
+  /// \param timeout in milliseconds, 0 means no deadline.
+  void deadline(qint64 timeout) { timeout_ = timeout; }
+  /// Remaining time before the deadline, in milliseconds.
+  /// \return -1 when there is no deadline.
+  qint64 remaining() const;
+  bool expired() const { return timeout_ > 0 && remaining() <= 0; }
+
+  void cancel() { cancelled_.storeRelease(1); }
+  bool isCancelled() const {
+    return cancelled_.loadAcquire() != 0 || expired();
+  }
+  bool isFinished() const;
+
+  static QString stateName(State state);
+
+ private:
+  Job(int id, const QString& name, const Work& work, const Done& done);
+
+  void run();
+
+  const int id_;
+  const QString name_;
+  Work work_;
+  Done done_;
+  qint64 timeout_;
+  QAtomicInt cancelled_;
+
+  mutable QMutex mutex_;
+  State state_;
+  QString message_;
+  QElapsedTimer created_;
+  qint64 started_, finished_;
+  /// Whether the JobQueue called the done function.
+  bool delivered_;
+
+  friend class JobQueue;
+};
+typedef QSharedPointer<Job> JobPtr_t;
+
+/// Runs jobs on a bounded thread pool.
+class JobQueue : public QObject {
+  Q_OBJECT
+
+ public:
+  /// Queued interactive jobs start before queued background jobs.
+  enum Priority { Background = 0, Interactive = 1 };
+
+  JobQueue(int maxThreadCount, QObject* parent = NULL);
+
+  ~JobQueue();
+
+  /// Schedule a job.
+  /// \param timeout deadline in milliseconds, starting now. 0 means none.
+  JobPtr_t submit(const QString& name, const Job::Work& work,
+                  const Job::Done& done = Job::Done(), qint64 timeout = 0,
+                  Priority priority = Interactive);
+
+  JobPtr_t job(int id) const;
+  QList<JobPtr_t> jobs() const;
+
+  /// Forget about the finished jobs, keeping the \c keep most recent ones.
+  /// The jobs whose done function was not called yet are kept.
+  void clearFinished(int keep = 0);
+
+  void waitForDone();
+  /// Whether every job submitted so far is finished and its done function
+  /// called.
+  bool isIdle() const;
+
+ public slots:
+  void cancel(int id);
+  void cancelAll();
+
+ signals:
+  /// Emitted whenever a job is queued, cancelled or finished.
+  void jobChanged(int id);
+  void jobFinished(int id);
+  /// Emitted after the last unfinished job is finished.
+  void idle();
+
+ private slots:
+  void finish(int id);
+
+ private:
+  class Runnable;
+
+  QThreadPool pool_;
+  mutable QMutex mutex_;
+  QList<JobPtr_t> jobs_;
+  int nextId_;
+  /// Number of jobs whose done function was not called yet.
+  int unfinished_;
+};
+
+/// Lists the jobs of a JobQueue with their state and duration.
+class JobListWidget : public QTreeWidget {
+  Q_OBJECT
+
+ public:
+  JobListWidget(JobQueue* queue, QWidget* parent = NULL);
+
+ public slots:
+  void cancelSelected();
+  void clearFinished();
+
+ private slots:
+  void jobChanged(int id);
+  void updateDurations();
+
+ private:
+  void updateItem(QTreeWidgetItem* item, const Job& job);
+
+  JobQueue* queue_;
+  QMap<int, QTreeWidgetItem*> items_;
+  QTimer* timer_;
+};
+}  // namespace plot
+}  // namespace hpp
+
+#endif  // HPP_PLOT_JOBQUEUE_HH
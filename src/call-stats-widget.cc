@@ -0,0 +1,159 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "hpp/plot/call-stats-widget.hh"
+
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include "hpp/plot/call-stats.hh"
+#include "hpp/plot/tracer.hh"
+
+namespace hpp {
+namespace plot {
+namespace {
+/// In microseconds, rounded to one decimal. A number, to sort numerically.
+double us(quint64 ns) { return (double)qRound64((double)ns * 1e-2) * .1; }
+}  // namespace
+
+CallStatsWidget::CallStatsWidget(QWidget* parent)
+    : QWidget(parent), table_(new QTreeWidget(this)), timer_(new QTimer(this)) {
+  table_->setColumnCount(9);
+  table_->setHeaderLabels(QStringList() << "Method"
+                                        << "Calls"
+                                        << "Errors"
+                                        << "Bytes"
+                                        << "p50 (us)"
+                                        << "p90 (us)"
+                                        << "p99 (us)"
+                                        << "p99.9 (us)"
+                                        << "Max (us)");
+  table_->setRootIsDecorated(false);
+  table_->setSortingEnabled(true);
+
+  QPushButton* reset =
+      new QPushButton(QIcon::fromTheme("edit-clear"), "&Reset", this);
+  QPushButton* dump =
+      new QPushButton(QIcon::fromTheme("document-save-as"), "&Dump...", this);
+  QPushButton* trace = new QPushButton("&Trace", this);
+  trace->setCheckable(true);
+  trace->setChecked(Tracer::enabled());
+  trace->setToolTip(
+      tr("Record the GUI operations, the server calls and the jobs"));
+  QPushButton* saveTrace = new QPushButton(QIcon::fromTheme("document-save-as"),
+                                           "Save tr&ace...", this);
+  connect(reset, SIGNAL(clicked()), SLOT(reset()));
+  connect(dump, SIGNAL(clicked()), SLOT(dump()));
+  connect(trace, SIGNAL(toggled(bool)), SLOT(enableTracing(bool)));
+  connect(saveTrace, SIGNAL(clicked()), SLOT(saveTrace()));
+
+  QHBoxLayout* buttons = new QHBoxLayout;
+  buttons->addWidget(trace);
+  buttons->addWidget(saveTrace);
+  buttons->addStretch();
+  buttons->addWidget(reset);
+  buttons->addWidget(dump);
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->addLayout(buttons);
+  layout->addWidget(table_);
+
+  connect(timer_, SIGNAL(timeout()), SLOT(refresh()));
+  timer_->start(1000);
+}
+
+void CallStatsWidget::refresh() {
+  // Only refresh what is visible.
+  if (!isVisible()) return;
+  QList<CallStats::Method*> methods = CallStats::instance().methods();
+  foreach (const CallStats::Method* m, methods) {
+    QList<QTreeWidgetItem*> items =
+        table_->findItems(m->name, Qt::MatchExactly, 0);
+    QTreeWidgetItem* item;
+    if (items.isEmpty()) {
+      item = new QTreeWidgetItem(table_);
+      item->setText(0, m->name);
+    } else
+      item = items.first();
+    const LatencyHistogram& h = m->latency;
+    item->setData(1, Qt::DisplayRole, (qulonglong)m->calls.load());
+    item->setData(2, Qt::DisplayRole, (qulonglong)m->errors.load());
+    item->setData(3, Qt::DisplayRole, (qulonglong)m->bytes.load());
+    item->setData(4, Qt::DisplayRole, us(h.percentile(.5)));
+    item->setData(5, Qt::DisplayRole, us(h.percentile(.9)));
+    item->setData(6, Qt::DisplayRole, us(h.percentile(.99)));
+    item->setData(7, Qt::DisplayRole, us(h.percentile(.999)));
+    item->setData(8, Qt::DisplayRole, us(h.max()));
+  }
+}
+
+void CallStatsWidget::reset() {
+  CallStats::instance().reset();
+  refresh();
+}
+
+void CallStatsWidget::dump() {
+  QString filename = QFileDialog::getSaveFileName(
+      this, "Dump call statistics", "./hpp-calls.tsv",
+      tr("Tab separated values (*.tsv)"));
+  if (filename.isNull()) return;
+  if (!CallStats::instance().dump(filename))
+    QMessageBox::warning(this, "Dump call statistics",
+                         tr("Could not write %1").arg(filename));
+}
+
+void CallStatsWidget::enableTracing(bool enable) {
+  Tracer::instance().enable(enable);
+}
+
+void CallStatsWidget::saveTrace() {
+  QString filename = QFileDialog::getSaveFileName(
+      this, "Save trace", "./hpp-trace.json",
+      tr("Chrome trace event files (*.json)"));
+  if (filename.isNull()) return;
+  Tracer& tracer = Tracer::instance();
+  int n = tracer.flush(filename);
+  if (n < 0)
+    QMessageBox::warning(this, "Save trace",
+                         tr("Could not write %1").arg(filename));
+  else if (tracer.dropped() > 0)
+    QMessageBox::information(
+        this, "Save trace",
+        tr("%1 events saved. %2 events were dropped because a buffer was "
+           "full. Save the trace more often.")
+            .arg(n)
+            .arg(tracer.dropped()));
+}
+}  // namespace plot
+}  // namespace hpp
@@ -0,0 +1,154 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "hpp/plot/call-stats.hh"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace hpp {
+namespace plot {
+namespace {
+/// Position of the most significant bit. v must not be 0.
+int msb(quint64 v) {
+  int n = 0;
+  for (int s = 32; s > 0; s >>= 1) {
+    if (v >> s) {
+      v >>= s;
+      n += s;
+    }
+  }
+  return n;
+}
+}  // namespace
+
+int LatencyHistogram::index(quint64 ns) {
+  if (ns < (quint64)SubBuckets) return (int)ns;
+  int m = msb(ns);
+  int sub = (int)(ns >> (m - SubBucketBits)) - SubBuckets;
+  return (m - SubBucketBits + 1) * SubBuckets + sub;
+}
+
+quint64 LatencyHistogram::value(int index) {
+  if (index < SubBuckets) return (quint64)index;
+  int shift = index / SubBuckets - 1;
+  quint64 lower = (quint64)(SubBuckets + index % SubBuckets) << shift;
+  return lower + (((quint64)1 << shift) - 1);
+}
+
+void LatencyHistogram::record(quint64 ns) {
+  buckets_[index(ns)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_.fetch_add(ns, std::memory_order_relaxed);
+  quint64 m = max_.load(std::memory_order_relaxed);
+  while (ns > m &&
+         !max_.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (int i = 0; i < NbBuckets; ++i)
+    buckets_[i].store(0, std::memory_order_relaxed);
+  count_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  total_.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::percentile(double p) const {
+  quint64 n = count();
+  if (n == 0) return 0;
+  quint64 target = (quint64)std::ceil(p * (double)n);
+  if (target == 0) target = 1;
+  quint64 cumul = 0;
+  for (int i = 0; i < NbBuckets; ++i) {
+    cumul += buckets_[i].load(std::memory_order_relaxed);
+    if (cumul >= target) return std::min(value(i), max());
+  }
+  return max();
+}
+
+void CallStats::Method::reset() {
+  calls.store(0, std::memory_order_relaxed);
+  errors.store(0, std::memory_order_relaxed);
+  bytes.store(0, std::memory_order_relaxed);
+  latency.reset();
+}
+
+CallStats& CallStats::instance() {
+  static CallStats stats;
+  return stats;
+}
+
+CallStats::Method* CallStats::method(const QString& name) {
+  QMutexLocker lock(&mutex_);
+  Method*& m = methods_[name];
+  if (m == NULL) m = new Method(name);
+  return m;
+}
+
+QList<CallStats::Method*> CallStats::methods() const {
+  QMutexLocker lock(&mutex_);
+  return methods_.values();
+}
+
+void CallStats::reset() {
+  foreach (Method* m, methods()) m->reset();
+}
+
+void CallStats::dump(QTextStream& os) const {
+  os << "method\tcalls\terrors\tbytes\tmean_us\tp50_us\tp90_us\tp99_us\t"
+        "p999_us\tmax_us\n";
+  foreach (const Method* m, methods()) {
+    const LatencyHistogram& h = m->latency;
+    quint64 n = h.count();
+    os << m->name << '\t' << m->calls.load() << '\t' << m->errors.load()
+       << '\t' << m->bytes.load() << '\t'
+       << ((n > 0) ? (double)h.total() / (double)n * 1e-3 : 0.) << '\t'
+       << (double)h.percentile(.5) * 1e-3 << '\t'
+       << (double)h.percentile(.9) * 1e-3 << '\t'
+       << (double)h.percentile(.99) * 1e-3 << '\t'
+       << (double)h.percentile(.999) * 1e-3 << '\t' << (double)h.max() * 1e-3
+       << '\n';
+  }
+}
+
+bool CallStats::dump(const QString& filename) const {
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+  QTextStream os(&file);
+  dump(os);
+  return true;
+}
+}  // namespace plot
+}  // namespace hpp
@@ -0,0 +1,165 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "hpp/plot/circuit-breaker.hh"
+
+#include <QMutexLocker>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QtConcurrent>
+#else
+#include <QtCore>
+#endif
+
+namespace hpp {
+namespace plot {
+CircuitBreaker& CircuitBreaker::instance() {
+  static CircuitBreaker breaker;
+  return breaker;
+}
+
+CircuitBreaker::CircuitBreaker()
+    : state_(Closed),
+      failures_(0),
+      threshold_(3),
+      probing_(false),
+      cooldown_(1000),
+      initialCooldown_(1000),
+      maxCooldown_(30000) {}
+
+bool CircuitBreaker::allow() {
+  QMutexLocker lock(&mutex_);
+  switch (state_) {
+    case Closed:
+      // The failures count toward the threshold, as reachable() says.
+      return true;
+    case Open:
+      if (opened_.elapsed() < cooldown_) return false;
+      setState(HalfOpen);
+      probing_ = true;
+      if (!probe_) return true;
+      QtConcurrent::run(this, &CircuitBreaker::runProbe, probe_);
+      return false;
+    case HalfOpen:
+      if (probing_) return false;
+      probing_ = true;
+      if (!probe_) return true;
+      QtConcurrent::run(this, &CircuitBreaker::runProbe, probe_);
+      return false;
+  }
+  return true;
+}
+
+void CircuitBreaker::success() {
+  bool changed;
+  {
+    QMutexLocker lock(&mutex_);
+    failures_ = 0;
+    probing_ = false;
+    cooldown_ = initialCooldown_;
+    changed = setState(Closed);
+  }
+  if (changed) emit reachableChanged(true);
+}
+
+void CircuitBreaker::failure() {
+  bool changed = false;
+  {
+    QMutexLocker lock(&mutex_);
+    ++failures_;
+    if (state_ == HalfOpen) {
+      // The probe failed: wait longer before the next one.
+      probing_ = false;
+      cooldown_ = qMin(2 * cooldown_, maxCooldown_);
+      opened_.start();
+      setState(Open);
+    } else if (state_ == Closed && failures_ >= threshold_) {
+      opened_.start();
+      changed = setState(Open);
+    }
+  }
+  if (changed) emit reachableChanged(false);
+}
+
+void CircuitBreaker::reset() {
+  bool changed;
+  {
+    QMutexLocker lock(&mutex_);
+    failures_ = 0;
+    probing_ = false;
+    cooldown_ = initialCooldown_;
+    changed = setState(Closed);
+  }
+  if (changed) emit reachableChanged(true);
+}
+
+void CircuitBreaker::setProbe(const Probe& probe) {
+  QMutexLocker lock(&mutex_);
+  probe_ = probe;
+}
+
+void CircuitBreaker::runProbe(Probe probe) {
+  try {
+    probe();
+  } catch (const CORBA::Exception& e) {
+    if (isUnreachable(e)) {
+      failure();
+      return;
+    }
+  }
+  success();
+}
+
+CircuitBreaker::State CircuitBreaker::state() const {
+  QMutexLocker lock(&mutex_);
+  return state_;
+}
+
+void CircuitBreaker::setCooldown(qint64 msec, qint64 maxMsec) {
+  QMutexLocker lock(&mutex_);
+  initialCooldown_ = qMax<qint64>(1, msec);
+  maxCooldown_ = qMax(initialCooldown_, maxMsec);
+  cooldown_ = initialCooldown_;
+}
+
+bool CircuitBreaker::isUnreachable(const CORBA::Exception& e) {
+  return CORBA::TRANSIENT::_downcast(&e) != NULL ||
+         CORBA::COMM_FAILURE::_downcast(&e) != NULL ||
+         CORBA::TIMEOUT::_downcast(&e) != NULL;
+}
+
+bool CircuitBreaker::setState(State state) {
+  bool wasReachable = (state_ == Closed);
+  state_ = state;
+  return wasReachable != (state_ == Closed);
+}
+}  // namespace plot
+}  // namespace hpp
@@ -34,24 +34,55 @@
 #include <qmath.h>
 
 #include <QDebug>
+#include <QDir>
 #include <QFileDialog>
 #include <QGraphicsSceneDragDropEvent>
 #include <QHBoxLayout>
+#include <QImage>
+#include <QInputDialog>
 #include <QMenu>
+#include <QMessageBox>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
 #include <QPushButton>
 #include <QScrollBar>
 #include <QSplitter>
+#include <QStyleOptionGraphicsItem>
+#include <QTemporaryFile>
+#include <QToolButton>
 #include <QVBoxLayout>
 #include <QWheelEvent>
+#include <cmath>
 
 #include "QGVEdge.h"
 #include "QGVNode.h"
 #include "QGVScene.h"
 #include "QGVSubGraph.h"
+#include "hpp/plot/call-stats.hh"
+#include "hpp/plot/scene-export.hh"
+#include "hpp/plot/tracer.hh"
 
 namespace hpp {
 namespace plot {
-GraphView::GraphView(QWidget *parent) : QGraphicsView(parent) {
+GraphView::GraphView(QWidget *parent)
+    : QGraphicsView(parent),
+      hud_(false),
+      updateMode_(viewportUpdateMode()),
+      frameTime_(0),
+      meanFrameTime_(0),
+      queryTime_(0),
+      splineTime_(0),
+      labelTime_(0),
+      nbItems_(0),
+      nbEdges_(0),
+      lod_(true),
+      simplified_(false),
+      lodDirty_(true),
+      antialiasing_(true),
+      lodThreshold_(.35),
+      dragging_(false),
+      previewing_(false) {
   setTransformationAnchor(AnchorUnderMouse);
   setDragMode(ScrollHandDrag);
   setBackgroundBrush(QBrush(Qt::lightGray, Qt::SolidPattern));
@@ -64,11 +95,431 @@ void GraphView::wheelEvent(QWheelEvent *event) {
                        .scale(scaleFactor, scaleFactor)
                        .mapRect(QRectF(0, 0, 1, 1))
                        .width();
-    if (0.05 < factor && factor < 10)  // Zoom factor limitation
+    if (0.05 < factor && factor < 10) {  // Zoom factor limitation
       scale(scaleFactor, scaleFactor);
+      updateLevelOfDetail();
+    }
   }
 }
 
+void GraphView::mousePressEvent(QMouseEvent *event) {
+  if (event->button() == Qt::LeftButton &&
+      event->modifiers() & Qt::ShiftModifier)
+    setDragMode(RubberBandDrag);
+  QGraphicsView::mousePressEvent(event);
+
+  QGVNode *grabbed = (scene() == NULL)
+                         ? NULL
+                         : dynamic_cast<QGVNode *>(scene()->mouseGrabberItem());
+  if (event->button() != Qt::LeftButton || grabbed == NULL) return;
+  // Find the edges of the nodes that will move.
+  QSet<QGVNode *> moving;
+  moving.insert(grabbed);
+  foreach (QGraphicsItem *item, scene()->selectedItems()) {
+    QGVNode *node = dynamic_cast<QGVNode *>(item);
+    if (node != NULL) moving.insert(node);
+  }
+  if (!previewing_) dragEdges_.clear();
+  for (QMap<QGVEdge *, QPair<QGVNode *, QGVNode *> >::const_iterator it =
+           edgeEnds_.constBegin();
+       it != edgeEnds_.constEnd(); ++it)
+    if ((moving.contains(it.value().first) ||
+         moving.contains(it.value().second)) &&
+        !dragEdges_.contains(it.key()))
+      dragEdges_.append(it.key());
+  dragging_ = true;
+}
+
+void GraphView::mouseMoveEvent(QMouseEvent *event) {
+  QGraphicsView::mouseMoveEvent(event);
+  if (!dragging_) return;
+  if (!previewing_) {
+    foreach (QGVEdge *edge, dragEdges_) edge->setVisible(false);
+    previewing_ = true;
+  }
+  viewport()->update();
+}
+
+void GraphView::mouseReleaseEvent(QMouseEvent *event) {
+  QGraphicsView::mouseReleaseEvent(event);
+  if (dragMode() == RubberBandDrag) setDragMode(ScrollHandDrag);
+  dragging_ = false;
+  if (!previewing_) dragEdges_.clear();
+}
+
+void GraphView::endDragPreview() {
+  if (!simplified_)
+    foreach (QGVEdge *edge, dragEdges_) edge->setVisible(true);
+  dragEdges_.clear();
+  previewing_ = false;
+  viewport()->update();
+}
+
+void GraphView::showHud(bool show) {
+  if (show == hud_) return;
+  hud_ = show;
+  // The overlay is fixed in the viewport. Scrolling must not move it.
+  if (hud_) {
+    updateMode_ = viewportUpdateMode();
+    setViewportUpdateMode(FullViewportUpdate);
+    lastCostMeasure_.invalidate();
+  } else
+    setViewportUpdateMode(updateMode_);
+  viewport()->update();
+}
+
+void GraphView::setLevelOfDetail(bool enable, qreal threshold) {
+  lod_ = enable;
+  lodThreshold_ = threshold;
+  prepareItems();
+  viewport()->update();
+}
+
+void GraphView::updateLevelOfDetail() {
+  // Showing or hiding every item is costly: it is not done while painting.
+  bool simplify =
+      lod_ && QStyleOptionGraphicsItem::levelOfDetailFromTransform(
+                  transform()) < lodThreshold_;
+  if (simplify != simplified_) setSimplified(simplify);
+}
+
+void GraphView::addEdgeEnds(QGVEdge *edge, QGVNode *start, QGVNode *end) {
+  edgeEnds_[edge] = qMakePair(start, end);
+  lodDirty_ = true;
+}
+
+void GraphView::clearItems() {
+  edgeEnds_.clear();
+  dragEdges_.clear();
+  dragging_ = previewing_ = false;
+  staleNodes_.clear();
+  staleEdges_.clear();
+  lodDirty_ = true;
+}
+
+void GraphView::prepareItems() {
+  if (scene() == NULL) return;
+  // Nodes are small and their text is expensive to render. Edges are only
+  // cached when their pixmap would stay small.
+  const qreal maxCachedArea = 256 * 256;
+  int n = 0;
+  foreach (QGraphicsItem *item, scene()->items()) {
+    ++n;
+    QGraphicsItem::CacheMode mode = QGraphicsItem::NoCache;
+    if (lod_ && dynamic_cast<QGVNode *>(item) != NULL)
+      mode = QGraphicsItem::DeviceCoordinateCache;
+    else if (lod_ && dynamic_cast<QGVEdge *>(item) != NULL) {
+      QRectF r = item->boundingRect();
+      if (r.width() * r.height() < maxCachedArea)
+        mode = QGraphicsItem::DeviceCoordinateCache;
+    }
+    item->setCacheMode(mode);
+  }
+  // The layout is static: fix the depth of the BSP tree instead of
+  // letting the scene estimate it again each time items are added.
+  scene()->setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+  scene()->setBspTreeDepth(
+      qBound(4, (int)std::ceil(std::log((double)qMax(n, 2)) / std::log(4.)),
+             10));
+
+  if (simplified_) setSimplified(true);
+  updateLevelOfDetail();
+  lodDirty_ = true;
+}
+
+void GraphView::setSimplified(bool simplified) {
+  if (simplified && !simplified_)
+    antialiasing_ = renderHints() & QPainter::Antialiasing;
+  simplified_ = simplified;
+  if (!simplified_) {
+    foreach (QGVNode *node, staleNodes_) node->updateLayout();
+    foreach (QGVEdge *edge, staleEdges_) edge->updateLayout();
+    staleNodes_.clear();
+    staleEdges_.clear();
+  }
+  if (scene() != NULL) {
+    foreach (QGraphicsItem *item, scene()->items()) {
+      if (dynamic_cast<QGVNode *>(item) != NULL ||
+          dynamic_cast<QGVEdge *>(item) != NULL)
+        item->setVisible(!simplified_);
+    }
+  }
+  if (previewing_)
+    foreach (QGVEdge *edge, dragEdges_) edge->setVisible(false);
+  setRenderHint(QPainter::Antialiasing, !simplified_ && antialiasing_);
+}
+
+void GraphView::buildLod() {
+  lodNodes_.clear();
+  lodNodeColors_.clear();
+  lodEdges_.clear();
+  lodDirty_ = false;
+  if (scene() == NULL) return;
+  foreach (QGraphicsItem *item, scene()->items()) {
+    QGVNode *node = dynamic_cast<QGVNode *>(item);
+    if (node == NULL) continue;
+    QColor color(node->getAttribute("fillcolor"));
+    lodNodes_.append(node->sceneBoundingRect());
+    lodNodeColors_.append(color.isValid() ? color : QColor(Qt::white));
+  }
+  for (QMap<QGVEdge *, QPair<QGVNode *, QGVNode *> >::const_iterator it =
+           edgeEnds_.constBegin();
+       it != edgeEnds_.constEnd(); ++it) {
+    if (it.value().first == it.value().second) continue;
+    QColor color(it.key()->getAttribute("color"));
+    if (!color.isValid()) color = Qt::black;
+    lodEdges_[color.rgba()].append(
+        QLineF(it.value().first->sceneBoundingRect().center(),
+               it.value().second->sceneBoundingRect().center()));
+  }
+}
+
+void GraphView::drawBackground(QPainter *painter, const QRectF &rect) {
+  QGraphicsView::drawBackground(painter, rect);
+  if (simplified_) drawSimplified(painter, rect);
+}
+
+void GraphView::drawSimplified(QPainter *painter, const QRectF &rect) {
+  if (lodDirty_) buildLod();
+  HPP_PLOT_TRACE("paintSimplified");
+  painter->save();
+  painter->setRenderHint(QPainter::Antialiasing, false);
+  for (QMap<QRgb, QVector<QLineF> >::const_iterator it = lodEdges_.constBegin();
+       it != lodEdges_.constEnd(); ++it) {
+    painter->setPen(QPen(QColor::fromRgba(it.key()), 0));
+    painter->drawLines(it.value());
+  }
+  painter->setPen(QPen(Qt::black, 0));
+  for (int i = 0; i < lodNodes_.size(); ++i) {
+    if (!rect.intersects(lodNodes_[i])) continue;
+    painter->setBrush(lodNodeColors_[i]);
+    painter->drawEllipse(lodNodes_[i]);
+  }
+  painter->restore();
+}
+
+void GraphView::paintEvent(QPaintEvent *event) {
+  HPP_PLOT_TRACE("paint");
+  if (!hud_) {
+    QGraphicsView::paintEvent(event);
+    return;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  QList<QGraphicsItem *> items;
+  if (scene() != NULL)
+    items = scene()->items(mapToScene(event->rect()).boundingRect(),
+                           Qt::IntersectsItemBoundingRect);
+  queryTime_ = (double)timer.nsecsElapsed() * 1e-6;
+  nbItems_ = items.size();
+
+  timer.start();
+  QGraphicsView::paintEvent(event);
+  frameTime_ = (double)timer.nsecsElapsed() * 1e-6;
+  meanFrameTime_ = (meanFrameTime_ == 0)
+                       ? frameTime_
+                       : .9 * meanFrameTime_ + .1 * frameTime_;
+
+  if (!lastCostMeasure_.isValid() || lastCostMeasure_.elapsed() > 1000) {
+    measureEdgeCost(items);
+    lastCostMeasure_.start();
+  }
+}
+
+void GraphView::drawForeground(QPainter *painter, const QRectF &rect) {
+  QGraphicsView::drawForeground(painter, rect);
+  if (previewing_) {
+    painter->save();
+    painter->setPen(QPen(Qt::darkGray, 0, Qt::DashLine));
+    foreach (QGVEdge *edge, dragEdges_) {
+      const QPair<QGVNode *, QGVNode *> &ends = edgeEnds_[edge];
+      painter->drawLine(ends.first->sceneBoundingRect().center(),
+                        ends.second->sceneBoundingRect().center());
+    }
+    painter->restore();
+  }
+  if (!hud_) return;
+  QStringList lines;
+  lines << QString("Frame: %1 ms (mean %2 ms)")
+               .arg(frameTime_, 0, 'f', 2)
+               .arg(meanFrameTime_, 0, 'f', 2)
+        << QString("Painted items: %1").arg(nbItems_)
+        << QString("Edges: %1, splines ~%2 ms, labels ~%3 ms")
+               .arg(nbEdges_)
+               .arg(splineTime_, 0, 'f', 2)
+               .arg(labelTime_, 0, 'f', 2)
+        << QString("Index query: %1 ms").arg(queryTime_, 0, 'f', 3);
+  QString text = lines.join("\n");
+
+  painter->save();
+  painter->resetTransform();
+  QFontMetrics fm(painter->font());
+  QRect box = fm.boundingRect(QRect(0, 0, 1000, 1000), Qt::AlignLeft, text)
+                  .adjusted(-4, -4, 4, 4)
+                  .translated(8, 8);
+  painter->setPen(Qt::NoPen);
+  painter->setBrush(QColor(0, 0, 0, 160));
+  painter->drawRect(box);
+  painter->setPen(Qt::white);
+  painter->drawText(box.adjusted(4, 4, -4, -4), Qt::AlignLeft, text);
+  painter->restore();
+}
+
+void GraphView::measureEdgeCost(const QList<QGraphicsItem *> &items) {
+  const int maxSamples = 200;
+  QList<QGVEdge *> edges;
+  foreach (QGraphicsItem *item, items) {
+    QGVEdge *edge = dynamic_cast<QGVEdge *>(item);
+    if (edge != NULL) edges.append(edge);
+  }
+  nbEdges_ = edges.size();
+  splineTime_ = labelTime_ = 0;
+  if (edges.isEmpty()) return;
+
+  QImage image(512, 512, QImage::Format_ARGB32_Premultiplied);
+  QPainter p(&image);
+  p.setRenderHints(renderHints());
+  QStyleOptionGraphicsItem option;
+  QElapsedTimer timer;
+  qint64 total = 0, labels = 0;
+  int n = qMin(maxSamples, edges.size());
+  for (int i = 0; i < n; ++i) {
+    // Spread the samples over the visible edges.
+    QGVEdge *edge = edges[i * edges.size() / n];
+    // Paint the edge at the scale of the view, inside the image.
+    QRectF r = transform().mapRect(edge->sceneBoundingRect());
+    p.setTransform(edge->sceneTransform() * transform() *
+                   QTransform::fromTranslate(-r.left(), -r.top()));
+    timer.start();
+    edge->paint(&p, &option, NULL);
+    total += timer.nsecsElapsed();
+
+    QString label = edge->label();
+    if (label.isEmpty()) continue;
+    timer.start();
+    p.drawText(edge->boundingRect(), Qt::AlignCenter, label);
+    labels += timer.nsecsElapsed();
+  }
+  // Extrapolate to all the visible edges.
+  double scale = (double)edges.size() / (double)n * 1e-6;
+  labelTime_ = (double)labels * scale;
+  splineTime_ = qMax(0., (double)(total - labels) * scale);
+}
+
+GraphView::FrameStats GraphView::benchmark(int steps) {
+  FrameStats stats = {0, 0, 0, 0, 0};
+  if (scene() == NULL || steps <= 0) return stats;
+
+  QTransform transform0 = transform();
+  QPointF center0 = mapToScene(viewport()->rect().center());
+  ViewportAnchor anchor0 = transformationAnchor();
+  setTransformationAnchor(AnchorViewCenter);
+
+  QRectF rect = scene()->itemsBoundingRect();
+  fitInView(rect, Qt::KeepAspectRatio);
+  QTransform fit = transform();
+
+  LatencyHistogram histogram;
+  QElapsedTimer timer;
+  qint64 total = 0;
+  for (int i = 0; i < steps; ++i) {
+    double t = (double)i / (double)steps;
+    // Zoom in up to 8 times and back while following a Lissajous curve.
+    double zoom = std::pow(8., std::sin(M_PI * t));
+    QPointF c(rect.center().x() + .4 * rect.width() * std::sin(4 * M_PI * t),
+              rect.center().y() + .4 * rect.height() * std::sin(6 * M_PI * t));
+    setTransform(fit * QTransform::fromScale(zoom, zoom));
+    updateLevelOfDetail();
+    centerOn(c);
+    timer.start();
+    viewport()->repaint();
+    qint64 ns = timer.nsecsElapsed();
+    histogram.record((quint64)ns);
+    total += ns;
+  }
+
+  setTransform(transform0);
+  updateLevelOfDetail();
+  centerOn(center0);
+  setTransformationAnchor(anchor0);
+
+  stats.frames = steps;
+  stats.mean = (double)total / steps * 1e-6;
+  stats.p50 = (double)histogram.percentile(.5) * 1e-6;
+  stats.p99 = (double)histogram.percentile(.99) * 1e-6;
+  stats.max = (double)histogram.max() * 1e-6;
+  return stats;
+}
+
+GraphOverview::GraphOverview(GraphView *view, QWidget *parent)
+    : QWidget(parent), view_(view), dirty_(true) {
+  setFixedHeight(160);
+  setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+  setCursor(Qt::PointingHandCursor);
+  // Scrolling and zooming move the rectangle of the view.
+  QScrollBar *bars[] = {view_->horizontalScrollBar(),
+                        view_->verticalScrollBar()};
+  for (int i = 0; i < 2; ++i) {
+    connect(bars[i], SIGNAL(valueChanged(int)), SLOT(update()));
+    connect(bars[i], SIGNAL(rangeChanged(int, int)), SLOT(update()));
+  }
+}
+
+void GraphOverview::invalidate() {
+  dirty_ = true;
+  update();
+}
+
+void GraphOverview::render() {
+  HPP_PLOT_TRACE("renderOverview");
+  dirty_ = false;
+  pixmap_ = QPixmap(size());
+  pixmap_.fill(view_->backgroundBrush().color());
+  transform_.reset();
+  if (view_->scene() == NULL) return;
+  QRectF rect = view_->scene()->itemsBoundingRect();
+  if (rect.isEmpty()) return;
+  qreal s = qMin(width() / rect.width(), height() / rect.height());
+  transform_ =
+      QTransform::fromTranslate(-rect.center().x(), -rect.center().y()) *
+      QTransform::fromScale(s, s) *
+      QTransform::fromTranslate(width() / 2., height() / 2.);
+  QPainter painter(&pixmap_);
+  painter.setTransform(transform_);
+  view_->drawSimplified(&painter, rect);
+}
+
+void GraphOverview::paintEvent(QPaintEvent *) {
+  if (dirty_ || pixmap_.size() != size()) render();
+  QPainter painter(this);
+  painter.drawPixmap(0, 0, pixmap_);
+  if (transform_.isIdentity()) return;
+  QRectF visible = view_->mapToScene(view_->viewport()->rect()).boundingRect();
+  painter.setPen(QPen(Qt::red, 1));
+  painter.setBrush(QColor(255, 0, 0, 40));
+  painter.drawRect(transform_.mapRect(visible));
+}
+
+void GraphOverview::mousePressEvent(QMouseEvent *event) {
+  if (event->button() != Qt::LeftButton || transform_.isIdentity()) return;
+  // Dragging the rectangle keeps the grabbed point under the pointer.
+  QRectF r = transform_.mapRect(
+      view_->mapToScene(view_->viewport()->rect()).boundingRect());
+  grabOffset_ = r.contains(event->pos()) ? r.center() - event->pos()
+                                          : QPointF();
+  moveView(event->pos());
+}
+
+void GraphOverview::mouseMoveEvent(QMouseEvent *event) {
+  if (event->buttons() & Qt::LeftButton && !transform_.isIdentity())
+    moveView(event->pos());
+}
+
+void GraphOverview::moveView(const QPointF &pos) {
+  view_->centerOn(transform_.inverted().map(pos + grabOffset_));
+}
+
 GraphWidget::GraphWidget(QString name, QWidget *parent)
     : QWidget(parent),
       scene_(new QGVScene(name, 0)),
@@ -77,6 +528,9 @@ GraphWidget::GraphWidget(QString name, QWidget *parent)
       loggingInfo_(new QTextEdit()),
       constraintInfo_(new QTextEdit()),
       view_(new GraphView(0)),
+      overview_(new GraphOverview(view_)),
+      viewMenu_(new QMenu(this)),
+      edgeUpdateTimer_(new QTimer(this)),
       layoutShouldBeFreed_(false) {
   view_->setScene(scene_);
 
@@ -99,6 +553,7 @@ GraphWidget::GraphWidget(QString name, QWidget *parent)
   infoL->addWidget(elmtInfo_);
   // infoL->addWidget(loggingInfo_);
   infoL->addWidget(constraintInfo_);
+  infoL->addWidget(overview_);
   infoW->setLayout(infoL);
   splitter->addWidget(infoW);
   splitter->addWidget(view_);
@@ -137,11 +592,31 @@ GraphWidget::GraphWidget(QString name, QWidget *parent)
       new QPushButton(QIcon::fromTheme("view-refresh"), "&Refresh", buttonBox_);
   QPushButton *update = new QPushButton(QIcon::fromTheme("view-refresh"),
                                         "&Update edges", buttonBox_);
+  QToolButton *viewButton = new QToolButton(buttonBox_);
+  viewButton->setText("&View");
+  viewButton->setPopupMode(QToolButton::InstantPopup);
+  viewButton->setMenu(viewMenu_);
+  QAction *lod = viewMenu_->addAction("Simplify when zoomed &out");
+  lod->setCheckable(true);
+  lod->setChecked(view_->levelOfDetail());
+  connect(lod, SIGNAL(toggled(bool)), SLOT(enableLevelOfDetail(bool)));
+  QAction *hud = viewMenu_->addAction("Show &frame statistics");
+  hud->setCheckable(true);
+  connect(hud, SIGNAL(toggled(bool)), SLOT(showFrameStats(bool)));
+  QAction *overview = viewMenu_->addAction("Show &overview");
+  overview->setCheckable(true);
+  overview->setChecked(true);
+  connect(overview, SIGNAL(toggled(bool)), overview_, SLOT(setVisible(bool)));
+  viewMenu_->addAction("&Benchmark pan and zoom", this, SLOT(benchmarkView()));
+  viewMenu_->addSeparator();
+  viewMenu_->addAction(QIcon::fromTheme("document-export"), "&Export image...",
+                       this, SLOT(saveImage()));
   buttonBox_->setLayout(hLayout);
   buttonBox_->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Minimum);
   hLayout->setAlignment(buttonBox_, Qt::AlignRight);
   hLayout->addSpacerItem(
       new QSpacerItem(0, 0, QSizePolicy::Expanding, QSizePolicy::Minimum));
+  hLayout->addWidget(viewButton);
   hLayout->addWidget(algList_);
   hLayout->addWidget(saveas);
   hLayout->addWidget(update);
@@ -150,23 +625,60 @@ GraphWidget::GraphWidget(QString name, QWidget *parent)
   connect(refresh, SIGNAL(clicked()), this, SLOT(updateGraph()));
   connect(update, SIGNAL(clicked()), this, SLOT(updateEdges()));
 
+  // Wait for the user to stop dragging nodes before routing their edges.
+  edgeUpdateTimer_->setSingleShot(true);
+  edgeUpdateTimer_->setInterval(300);
+  connect(edgeUpdateTimer_, SIGNAL(timeout()), SLOT(updateMovedEdges()));
   connect(scene_, SIGNAL(nodeMouseRelease(QGVNode *)), this,
-          SLOT(updateEdges()));
+          SLOT(scheduleEdgeUpdate()));
 }
 
 GraphWidget::~GraphWidget() { delete scene_; }
 
-void GraphWidget::updateGraph() {
+void GraphWidget::addButton(QAction *action) {
+  QToolButton *button = new QToolButton(buttonBox_);
+  button->setDefaultAction(action);
+  button->setToolButtonStyle(Qt::ToolButtonTextBesideIcon);
+  buttonBox_->layout()->addWidget(button);
+  addAction(action);
+}
+
+void GraphWidget::addInfoWidget(QWidget *widget) {
+  QBoxLayout *layout =
+      static_cast<QBoxLayout *>(overview_->parentWidget()->layout());
+  layout->insertWidget(layout->indexOf(overview_), widget);
+}
+
+void GraphWidget::updateGraph() { layoutGraph(algList_->currentText()); }
+
+void GraphWidget::layoutGraph(const QString &algorithm) {
+  HPP_PLOT_TRACE("updateGraph");
+  edgeUpdateTimer_->stop();
   // Layout scene
   if (layoutShouldBeFreed_) scene_->freeLayout();
-  scene_->clear();
+  {
+    HPP_PLOT_TRACE("clearScene");
+    scene_->clear();
+    view_->clearItems();
+  }
   QRectF rect = view_->sceneRect();
   rect.setWidth(0);
   rect.setHeight(0);
   view_->setSceneRect(rect);
-  fillScene();
-  scene_->applyLayout(algList_->currentText());
+  {
+    HPP_PLOT_TRACE("fillScene");
+    fillScene();
+  }
+  // Keep the positions given by fillScene and only route the edges.
+  if (algorithm == "nop2") scene_->setNodePositionAttribute();
+  {
+    HPP_PLOT_TRACE("applyLayout");
+    scene_->applyLayout(algorithm);
+  }
   layoutShouldBeFreed_ = true;
+  attachEdgeSplines();
+  view_->prepareItems();
+  overview_->invalidate();
 
   scene_->setNodePositionAttribute();
   scene_->setGraphAttribute("splines", "spline");
@@ -180,12 +692,49 @@ void GraphWidget::updateGraph() {
 }
 
 void GraphWidget::updateEdges() {
+  HPP_PLOT_TRACE("updateEdges");
+  QList<QGVEdge *> edges;
+  foreach (QGraphicsItem *item, scene_->items()) {
+    QGVEdge *edge = dynamic_cast<QGVEdge *>(item);
+    if (edge != NULL) edges.append(edge);
+  }
+  routeEdges(edges);
+}
+
+void GraphWidget::updateMovedEdges() {
+  HPP_PLOT_TRACE("updateMovedEdges");
+  routeEdges(view_->dragEdges());
+}
+
+void GraphWidget::routeEdges(const QList<QGVEdge *> &edges) {
+  edgeUpdateTimer_->stop();
+  foreach (QGVEdge *edge, edges) edge->setAttribute("pos", "");
+  scene_->setNodePositionAttribute();
   // Layout scene
   if (layoutShouldBeFreed_) scene_->freeLayout();
   scene_->applyLayout("nop2");
   layoutShouldBeFreed_ = true;
+  attachEdgeSplines();
+  view_->invalidateLod();
+  view_->endDragPreview();
+  overview_->invalidate();
+}
+
+void GraphWidget::attachEdgeSplines() {
+  HPP_PLOT_TRACE("attachEdgeSplines");
+  // QGVScene draws the splines of the layout without writing them in the
+  // graph. Rendering it to DOT attaches them as "pos" attributes.
+  QTemporaryFile file(QDir::temp().filePath("hpp-plot-XXXXXX.dot"));
+  if (!file.open()) {
+    qDebug() << "Cannot keep the edge splines:" << file.errorString();
+    return;
+  }
+  file.close();
+  scene_->render("dot", file.fileName());
 }
 
+void GraphWidget::scheduleEdgeUpdate() { edgeUpdateTimer_->start(); }
+
 void GraphWidget::saveDotFile() {
   QString filename = QFileDialog::getSaveFileName(
       this, "Save DOT file", "./graph.dot", tr("DOT files (*.dot)"));
@@ -194,6 +743,50 @@ void GraphWidget::saveDotFile() {
   }
 }
 
+bool GraphWidget::exportImage(const QString &filename, qreal scale) {
+  view_->showAllItems();
+  bool ok = exportScene(scene_, filename, scale);
+  view_->updateLevelOfDetail();
+  return ok;
+}
+
+void GraphWidget::saveImage() {
+  QString filename = QFileDialog::getSaveFileName(
+      this, "Export image", "./graph.png",
+      tr("PNG images (*.png);;PDF files (*.pdf)"));
+  if (filename.isNull()) return;
+  qreal scale = 1;
+  if (!filename.endsWith(".pdf", Qt::CaseInsensitive)) {
+    bool ok;
+    scale = QInputDialog::getDouble(this, "Export image",
+                                    "Pixels per point:", 2, .1, 100, 1, &ok);
+    if (!ok) return;
+  }
+  if (!exportImage(filename, scale))
+    QMessageBox::warning(this, "Export image",
+                         tr("Could not write %1.").arg(filename));
+}
+
+void GraphWidget::showFrameStats(bool show) { view_->showHud(show); }
+
+void GraphWidget::enableLevelOfDetail(bool enable) {
+  view_->setLevelOfDetail(enable);
+}
+
+void GraphWidget::benchmarkView() {
+  GraphView::FrameStats stats = view_->benchmark();
+  QString msg = QString(
+                    "%1 frames\nmean: %2 ms\np50: %3 ms\np99: %4 ms\n"
+                    "max: %5 ms")
+                    .arg(stats.frames)
+                    .arg(stats.mean, 0, 'f', 2)
+                    .arg(stats.p50, 0, 'f', 2)
+                    .arg(stats.p99, 0, 'f', 2)
+                    .arg(stats.max, 0, 'f', 2);
+  qDebug() << "Pan and zoom benchmark:" << msg;
+  QMessageBox::information(this, "Pan and zoom benchmark", msg);
+}
+
 void GraphWidget::nodeContextMenu(QGVNode *node) { Q_UNUSED(node) }
 
 void GraphWidget::nodeDoubleClick(QGVNode *node) { Q_UNUSED(node) }
@@ -202,6 +795,31 @@ void hpp::plot::GraphWidget::edgeDoubleClick(QGVEdge *edge) { Q_UNUSED(edge) }
 
 void hpp::plot::GraphWidget::edgeContextMenu(QGVEdge *edge) { Q_UNUSED(edge) }
 
+QGVEdge *GraphWidget::addEdge(QGVNode *start, QGVNode *end,
+                              const QString &label) {
+  QGVEdge *edge = scene_->addEdge(start, end, label);
+  view_->addEdgeEnds(edge, start, end);
+  return edge;
+}
+
+void GraphWidget::updateStyle(QGVNode *node) {
+  if (view_->simplified())
+    view_->deferLayout(node);
+  else
+    node->updateLayout();
+  view_->invalidateLod();
+  overview_->invalidate();
+}
+
+void GraphWidget::updateStyle(QGVEdge *edge) {
+  if (view_->simplified())
+    view_->deferLayout(edge);
+  else
+    edge->updateLayout();
+  view_->invalidateLod();
+  overview_->invalidate();
+}
+
 void GraphWidget::fillScene() {
   // Configure scene attributes
   scene_->setGraphAttribute("label", "DEMO");
@@ -233,21 +851,21 @@ void GraphWidget::fillScene() {
   node5->setIcon(QImage(":/icons/Gnome-Network-Server-64.png"));
 
   // Add some edges
-  scene_->addEdge(node1, node2, "TTL")->setAttribute("color", "red");
-  scene_->addEdge(node1, node2, "SERIAL");
-  scene_->addEdge(node1, node3, "RAZ")->setAttribute("color", "blue");
-  scene_->addEdge(node2, node3, "SECU");
+  addEdge(node1, node2, "TTL")->setAttribute("color", "red");
+  addEdge(node1, node2, "SERIAL");
+  addEdge(node1, node3, "RAZ")->setAttribute("color", "blue");
+  addEdge(node2, node3, "SECU");
 
-  scene_->addEdge(node2, node4, "STATUS")->setAttribute("color", "red");
+  addEdge(node2, node4, "STATUS")->setAttribute("color", "red");
 
-  scene_->addEdge(node4, node3, "ACK")->setAttribute("color", "red");
+  addEdge(node4, node3, "ACK")->setAttribute("color", "red");
 
-  scene_->addEdge(node4, node2, "TBIT");
-  scene_->addEdge(node4, node2, "ETH");
-  scene_->addEdge(node4, node2, "RS232");
+  addEdge(node4, node2, "TBIT");
+  addEdge(node4, node2, "ETH");
+  addEdge(node4, node2, "RS232");
 
-  scene_->addEdge(node4, node5, "ETH1");
-  scene_->addEdge(node2, node5, "ETH2");
+  addEdge(node4, node5, "ETH1");
+  addEdge(node2, node5, "ETH2");
 
   QGVSubGraph *sgraph = scene_->addSubGraph("SUB1");
   sgraph->setAttribute("label", "OFFICE");
@@ -255,14 +873,14 @@ void GraphWidget::fillScene() {
   QGVNode *snode1 = sgraph->addNode("PC0152");
   QGVNode *snode2 = sgraph->addNode("PC0153");
 
-  scene_->addEdge(snode1, snode2, "RT7");
+  addEdge(snode1, snode2, "RT7");
 
-  scene_->addEdge(node3, snode1, "GB8");
-  scene_->addEdge(node3, snode2, "TS9");
+  addEdge(node3, snode1, "GB8");
+  addEdge(node3, snode2, "TS9");
 
   QGVSubGraph *ssgraph = sgraph->addSubGraph("SUB2");
   ssgraph->setAttribute("label", "DESK");
-  scene_->addEdge(snode1, ssgraph->addNode("PC0155"), "S10");
+  addEdge(snode1, ssgraph->addNode("PC0155"), "S10");
 }
 }  // namespace plot
 }  // namespace hpp
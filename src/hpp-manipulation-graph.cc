@@ -33,21 +33,51 @@
 
 #include <QGVEdge.h>
 #include <QGVNode.h>
+#include <QGVSubGraph.h>
 #include <QtGui/qtextdocument.h>
 #include <assert.h>
 
+#include <QComboBox>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QDialog>
+#include <QDialogButtonBox>
 #include <QDir>
+#include <QDoubleSpinBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QFuture>
 #include <QInputDialog>
+#include <QLabel>
 #include <QLayout>
+#include <QLineEdit>
+#include <QListWidget>
 #include <QMap>
 #include <QMenu>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QSet>
 #include <QTemporaryFile>
 #include <QTimer>
+#include <QUndoCommand>
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <utility>
+#include <vector>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QtConcurrent>
+#else
+#include <QtCore>
+#endif
+
+#include "hpp/plot/call-stats.hh"
+#include "hpp/plot/tracer.hh"
 
 #if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
 #define ESCAPE(q) Qt::escape(q)
@@ -63,6 +93,402 @@ void initConfigProjStat(::hpp::ConfigProjStat& p) {
   p.error = 0;
   p.nbObs = 0;
 }
+
+void addConfigProjStat(::hpp::ConfigProjStat& sum,
+                       const ::hpp::ConfigProjStat& p) {
+  sum.success += p.success;
+  sum.error += p.error;
+  sum.nbObs += p.nbObs;
+}
+
+/// Whether an element passes the filters of a search. weight and freq are
+/// NaN for the elements that have none.
+bool acceptFilters(const QList<SearchFilter>& filters,
+                   const ::hpp::ConfigProjStat& stat, double weight,
+                   double freq) {
+  foreach (const SearchFilter& f, filters) {
+    double v;
+    if (f.field == "weight")
+      v = weight;
+    else if (f.field == "freq")
+      v = freq;
+    else if (f.field == "obs")
+      v = stat.nbObs;
+    else if (stat.nbObs > 0)
+      v = (double)stat.success / (double)stat.nbObs;
+    else
+      return false;
+    if (std::isnan(v) || !f.accepts(v)) return false;
+  }
+  return true;
+}
+
+const QStringList& filterFields() {
+  static const QStringList fields = QStringList() << "success rate"
+                                                  << "rate"
+                                                  << "weight"
+                                                  << "freq"
+                                                  << "obs";
+  return fields;
+}
+
+/// Root of the set of id, in a union-find forest.
+hpp::ID findRoot(QMap<hpp::ID, hpp::ID>& parent, hpp::ID id) {
+  while (parent[id] != id) {
+    parent[id] = parent[parent[id]];
+    id = parent[id];
+  }
+  return id;
+}
+
+/// Readable message of an exception raised by a server call.
+QString errorMessage(const CORBA::Exception& e) {
+  const hpp::Error* error = dynamic_cast<const hpp::Error*>(&e);
+  if (error != NULL) return QString(error->msg.in());
+  return QString(e._name());
+}
+
+/// Color key of a success rate in [0, 1].
+int rateColor(float sr) { return qBound(0, (int)(sr * 255), 255); }
+
+/// A call to one of the servers whose statistics are polled. Only the
+/// calls to the main server go through the CircuitBreaker.
+template <typename F>
+auto instanceCall(bool main, CallStats::Method* method, F f)
+    -> decltype(f()) {
+  if (main) return timedCall(method, f);
+  return recordedCall(method, f);
+}
+
+/// Color key of an element from its statistics.
+int statColor(const ::hpp::ConfigProjStat& s) {
+  return (s.nbObs > 0) ? rateColor((float)s.success / (float)s.nbObs)
+                       : (int)HppManipulationGraphWidget::DefaultColor;
+}
+
+/// HTML summary of the number of roadmap nodes per connected component:
+/// the largest components and a histogram of the sizes, with power of two
+/// bins. Its length does not depend on the number of components and it is
+/// computed in one pass.
+QString summarizeComponents(const ::hpp::intSeq& freqPerCC) {
+  const int topK = 10, nbBins = 32;
+  // Min-heap of the largest components: (size, index).
+  std::vector<std::pair<CORBA::Long, CORBA::ULong> > top;
+  top.reserve(topK + 1);
+  int bins[nbBins] = {0};
+  int nbEmpty = 0, lastBin = -1;
+  for (CORBA::ULong i = 0; i < freqPerCC.length(); ++i) {
+    CORBA::Long n = freqPerCC[i];
+    if (n <= 0) {
+      ++nbEmpty;
+      continue;
+    }
+    int bin = 0;
+    while (bin < nbBins - 1 && (n >> (bin + 1)) > 0) ++bin;
+    ++bins[bin];
+    lastBin = std::max(lastBin, bin);
+    if ((int)top.size() < topK || n > top.front().first) {
+      top.push_back(std::make_pair(n, i));
+      std::push_heap(top.begin(), top.end(),
+                     std::greater<std::pair<CORBA::Long, CORBA::ULong> >());
+      if ((int)top.size() > topK) {
+        std::pop_heap(top.begin(), top.end(),
+                      std::greater<std::pair<CORBA::Long, CORBA::ULong> >());
+        top.pop_back();
+      }
+    }
+  }
+  std::sort_heap(top.begin(), top.end(),
+                 std::greater<std::pair<CORBA::Long, CORBA::ULong> >());
+
+  QString html("<p><h4>Connected components</h4>%1 components, %2 "
+               "without node in this state</p>");
+  html = html.arg(freqPerCC.length()).arg(nbEmpty);
+  if (top.empty()) return html;
+  html.append("<p>Largest components<ul>");
+  for (std::size_t i = 0; i < top.size(); ++i)
+    html.append(QString("<li>#%1: %2</li>")
+                    .arg(top[i].second)
+                    .arg(top[i].first));
+  html.append("</ul></p><p>Nodes per component<ul>");
+  for (int bin = 0; bin <= lastBin; ++bin) {
+    if (bins[bin] == 0) continue;
+    qint64 low = (qint64)1 << bin, high = ((qint64)1 << (bin + 1)) - 1;
+    html.append(QString("<li>%1: %2</li>")
+                    .arg((low == high) ? QString::number(low)
+                                       : QString("%1-%2").arg(low).arg(high))
+                    .arg(bins[bin]));
+  }
+  html.append("</ul></p>");
+  return html;
+}
+
+/// Success rate in [0, 1], -1 without observation.
+float successRate(const ::hpp::ConfigProjStat& s) {
+  return (s.nbObs > 0) ? (float)s.success / (float)s.nbObs : -1.f;
+}
+
+/// Change of the statistics of an element between a baseline and now.
+struct StatDelta {
+  hpp::ID id;
+  bool edge;
+  QString name;
+  float baseRate, rate;
+  qint64 baseObs, obs;
+  /// Failed projections, of configurations and of paths.
+  qint64 baseErrors, errors;
+
+  StatDelta(hpp::ID i = -1, bool e = false, const QString& n = QString())
+      : id(i), edge(e), name(n) {}
+
+  void set(const ::hpp::ConfigProjStat& baseConfig,
+           const ::hpp::ConfigProjStat& basePath,
+           const ::hpp::ConfigProjStat& config,
+           const ::hpp::ConfigProjStat& path) {
+    baseRate = successRate(baseConfig);
+    rate = successRate(config);
+    baseObs = baseConfig.nbObs;
+    obs = config.nbObs;
+    baseErrors = baseConfig.error + basePath.error;
+    errors = config.error + path.error;
+  }
+
+  bool rated() const { return baseRate >= 0 && rate >= 0; }
+
+  /// A change of the success rate of 50% or more gets the strongest color.
+  int colorKey() const {
+    if (!rated()) return HppManipulationGraphWidget::DefaultColor;
+    return HppManipulationGraphWidget::DeltaColor +
+           qBound(-255, (int)std::floor((rate - baseRate) * 510 + .5f), 255);
+  }
+
+  QString text() const {
+    QString t = QString("%1: ").arg(name);
+    if (rated())
+      t += QString("%1% -> %2%, ")
+               .arg(baseRate * 100, 0, 'f', 0)
+               .arg(rate * 100, 0, 'f', 0);
+    return t + QString("obs %1 -> %2, errors %3%4")
+                   .arg(baseObs)
+                   .arg(obs)
+                   .arg((errors >= baseErrors) ? "+" : "")
+                   .arg(errors - baseErrors);
+  }
+};
+
+/// The success rate dropped or there are new errors.
+bool isRegression(const StatDelta& d) {
+  return (d.rated() && d.rate < d.baseRate) ||
+         (d.baseObs > 0 && d.errors > d.baseErrors);
+}
+
+/// Order by drop of the success rate, then by number of new errors.
+bool worseRegression(const StatDelta& a, const StatDelta& b) {
+  float da = a.rated() ? a.baseRate - a.rate : 0,
+        db = b.rated() ? b.baseRate - b.rate : 0;
+  if (da != db) return da > db;
+  return a.errors - a.baseErrors > b.errors - b.baseErrors;
+}
+
+/// Fingerprint of the structure of a graph: the names, the ends and the
+/// waypoints of its elements.
+QByteArray graphRevision(const hpp::GraphComp& graph,
+                         const hpp::GraphElements& elmts) {
+  QByteArray bytes;
+  QDataStream out(&bytes, QIODevice::WriteOnly);
+  out << QByteArray((const char*)graph.name) << (qint64)graph.id;
+  for (CORBA::ULong i = 0; i < elmts.nodes.length(); ++i)
+    out << (qint64)elmts.nodes[i].id
+        << QByteArray((const char*)elmts.nodes[i].name);
+  for (CORBA::ULong i = 0; i < elmts.edges.length(); ++i) {
+    const hpp::GraphElement& e = elmts.edges[i];
+    out << (qint64)e.id << QByteArray((const char*)e.name) << (qint64)e.start
+        << (qint64)e.end << (quint32)e.waypoints.length();
+    for (CORBA::ULong k = 0; k < e.waypoints.length(); ++k)
+      out << (qint64)e.waypoints[k];
+  }
+  return QCryptographicHash::hash(bytes, QCryptographicHash::Sha1);
+}
+
+/// "HPPS"
+const quint32 SnapshotMagic = 0x48505053;
+const qint32 SnapshotVersion = 1;
+const char* const SnapshotFilter = "Snapshots (*.snapshot);;All files (*)";
+
+void writeStat(QDataStream& out, const ::hpp::ConfigProjStat& s) {
+  out << (qint32)s.success << (qint32)s.error << (qint32)s.nbObs;
+}
+
+void readStat(QDataStream& in, ::hpp::ConfigProjStat& s) {
+  qint32 success, error, nbObs;
+  in >> success >> error >> nbObs;
+  s.success = success;
+  s.error = error;
+  s.nbObs = nbObs;
+}
+
+void writeSeq(QDataStream& out, const ::hpp::intSeq& seq) {
+  QVector<qint32> v((int)seq.length());
+  for (int i = 0; i < v.size(); ++i) v[i] = seq[(CORBA::ULong)i];
+  out << v;
+}
+
+void readSeq(QDataStream& in, QVector< ::CORBA::Long>& seq) {
+  QVector<qint32> v;
+  in >> v;
+  seq.resize(v.size());
+  for (int i = 0; i < v.size(); ++i) seq[i] = v[i];
+}
+
+void writeNames(QDataStream& out, const ::hpp::Names_t& names) {
+  QStringList l;
+  for (CORBA::ULong i = 0; i < names.length(); ++i)
+    l << QString::fromLocal8Bit(names[i]);
+  out << l;
+}
+
+/// The Graphviz color of each key, computed once.
+const QString& nodeColor(int key) {
+  static QVector<QString> colors;
+  static const QString white("white"), green("green");
+  static QVector<QString> deltas;
+  if (colors.isEmpty()) {
+    colors.resize(256);
+    for (int i = 0; i < 256; ++i) colors[i] = QColor(255, i, i).name();
+    deltas.resize(511);
+    for (int d = -255; d <= 255; ++d)
+      deltas[d + 255] = (d < 0) ? QColor(255, 255 + d, 255 + d).name()
+                                : QColor(255 - d, 255, 255 - d).name();
+  }
+  if (key >= HppManipulationGraphWidget::DeltaColor - 255)
+    return deltas[qMin(key - HppManipulationGraphWidget::DeltaColor, 255) +
+                  255];
+  if (key >= 0) return colors[qMin(key, 255)];
+  return (key == HppManipulationGraphWidget::HighlightColor) ? green : white;
+}
+
+const QString& edgeColor(int key) {
+  static QVector<QString> colors;
+  static const QString none, green("green"), blue("blue");
+  static QVector<QString> deltas;
+  if (colors.isEmpty()) {
+    colors.resize(256);
+    for (int i = 0; i < 256; ++i) colors[i] = QColor(255 - i, 0, 0).name();
+    deltas.resize(511);
+    for (int d = -255; d <= 255; ++d)
+      deltas[d + 255] = (d < 0) ? QColor(128 - d / 2, 0, 0).name()
+                                : (d > 0) ? QColor(0, 128 + d / 2, 0).name()
+                                          : QString("gray");
+  }
+  if (key >= HppManipulationGraphWidget::DeltaColor - 255)
+    return deltas[qMin(key - HppManipulationGraphWidget::DeltaColor, 255) +
+                  255];
+  if (key >= 0) return colors[qMin(key, 255)];
+  switch (key) {
+    case HppManipulationGraphWidget::HighlightColor:
+    case HppManipulationGraphWidget::IncreaseColor:
+      return green;
+    case HppManipulationGraphWidget::DecreaseColor:
+      return blue;
+    default:
+      return none;
+  }
+}
+
+/// Evaluate an arithmetic expression of the current weight \c w.
+/// Supports numbers, w, parentheses, +, -, * and /.
+class WeightFormula {
+ public:
+  WeightFormula(const QString& expr, double w)
+      : expr_(expr.simplified().remove(' ')), w_(w), pos_(0), ok_(true) {}
+
+  bool eval(double& result) {
+    pos_ = 0;
+    ok_ = true;
+    result = sum();
+    return ok_ && pos_ == expr_.size();
+  }
+
+ private:
+  QChar peek() const { return pos_ < expr_.size() ? expr_[pos_] : QChar(); }
+
+  double sum() {
+    double v = product();
+    while (ok_ && (peek() == '+' || peek() == '-')) {
+      if (expr_[pos_++] == '+')
+        v += product();
+      else
+        v -= product();
+    }
+    return v;
+  }
+
+  double product() {
+    double v = factor();
+    while (ok_ && (peek() == '*' || peek() == '/')) {
+      if (expr_[pos_++] == '*')
+        v *= factor();
+      else
+        v /= factor();
+    }
+    return v;
+  }
+
+  double factor() {
+    QChar c = peek();
+    if (c == '-' || c == '+') {
+      ++pos_;
+      return (c == '-') ? -factor() : factor();
+    }
+    if (c == 'w') {
+      ++pos_;
+      return w_;
+    }
+    if (c == '(') {
+      ++pos_;
+      double v = sum();
+      if (peek() != ')') ok_ = false;
+      ++pos_;
+      return v;
+    }
+    int start = pos_;
+    while (peek().isDigit() || peek() == '.') ++pos_;
+    double v = expr_.mid(start, pos_ - start).toDouble(&ok_);
+    return v;
+  }
+
+  QString expr_;
+  double w_;
+  int pos_;
+  bool ok_;
+};
+
+class SetWeightsCommand : public QUndoCommand {
+ public:
+  SetWeightsCommand(HppManipulationGraphWidget* widget,
+                    const QMap<hpp::ID, ::CORBA::Long>& before,
+                    const QMap<hpp::ID, ::CORBA::Long>& after,
+                    const QString& text)
+      : QUndoCommand(text),
+        widget_(widget),
+        before_(before),
+        after_(after),
+        applied_(true) {}
+
+  void undo() { widget_->setWeights(before_); }
+  void redo() {
+    // The weights are set before the command is pushed.
+    if (applied_)
+      applied_ = false;
+    else
+      widget_->setWeights(after_);
+  }
+
+ private:
+  HppManipulationGraphWidget* widget_;
+  QMap<hpp::ID, ::CORBA::Long> before_, after_;
+  bool applied_;
+};
 }  // namespace
 GraphAction::GraphAction(HppManipulationGraphWidget* parent)
     : QAction(parent), gw_(parent) {
@@ -82,6 +508,30 @@ HppManipulationGraphWidget::HppManipulationGraphWidget(
                                      "&Show waypoints", buttonBox_)),
       statButton_(new QPushButton(QIcon::fromTheme("view-refresh"),
                                   "&Statistics", buttonBox_)),
+      weightsButton_(new QPushButton(QIcon::fromTheme("document-edit"),
+                                     "Edit &weights", buttonBox_)),
+      undoStack_(new QUndoStack(this)),
+      tuneButton_(new QPushButton(QIcon::fromTheme("system-run"),
+                                  "&Tune weights", buttonBox_)),
+      tuneAutoApply_(new QCheckBox("Auto apply", buttonBox_)),
+      tuneTimer_(new QTimer(this)),
+      tuneMinWeight_(1),
+      tuneMaxWeight_(100),
+      tuneMinObs_(20),
+      focusButton_(new QPushButton(QIcon::fromTheme("zoom-in"), "&Focus",
+                                   buttonBox_)),
+      focusHops_(new QSpinBox(buttonBox_)),
+      useCache_(false),
+      ratesShown_(false),
+      focusId_(-1),
+      clusterMode_(new QComboBox(buttonBox_)),
+      searchBox_(new QLineEdit(buttonBox_)),
+      instanceBox_(new QComboBox(buttonBox_)),
+      unreachable_(new QLabel("<b>Server unreachable</b>", buttonBox_)),
+      stale_(new QLabel("<b>Snapshot</b>", buttonBox_)),
+      snapshotButton_(new QPushButton(QIcon::fromTheme("document-save"),
+                                      "Snapshot", buttonBox_)),
+      regressions_(new QListWidget()),
       updateStatsTimer_(new QTimer(this)),
       currentId_(-1),
       showNodeId_(-1),
@@ -92,15 +542,133 @@ HppManipulationGraphWidget::HppManipulationGraphWidget(
   showWaypoints_->setChecked(false);
   buttonBox_->layout()->addWidget(statButton_);
   buttonBox_->layout()->addWidget(showWaypoints_);
+  buttonBox_->layout()->addWidget(weightsButton_);
+  weightsButton_->setToolTip(
+      "Edit the weights of the selected edges. Hold Shift to select with a "
+      "rubber band.");
+  tuneButton_->setCheckable(true);
+  tuneButton_->setToolTip(
+      "Periodically compute edge weights from the statistics. Enables the "
+      "statistics.");
+  tuneAutoApply_->setToolTip(
+      "Apply the suggested weights without asking for confirmation");
+  buttonBox_->layout()->addWidget(tuneButton_);
+  buttonBox_->layout()->addWidget(tuneAutoApply_);
+  tuneTimer_->setInterval(30000);
+  tuneTimer_->setSingleShot(false);
+  focusButton_->setCheckable(true);
+  focusButton_->setToolTip(
+      "Only show the neighborhood of the selected element. Right click on an "
+      "element to move the focus.");
+  focusHops_->setRange(1, 20);
+  focusHops_->setValue(2);
+  focusHops_->setSuffix(" hops");
+  buttonBox_->layout()->addWidget(focusButton_);
+  buttonBox_->layout()->addWidget(focusHops_);
+  clusterMode_->addItems(QStringList() << "No clusters"
+                                       << "Cluster by name prefix"
+                                       << "Cluster by waypoint edge"
+                                       << "Cluster by component");
+  clusterMode_->setToolTip(
+      "Draw groups of nodes as a single node. Double click on a cluster to "
+      "expand it and on its frame to collapse it. Waypoint edges are only "
+      "clustered when the waypoints are shown.");
+  buttonBox_->layout()->addWidget(clusterMode_);
+  QMenu* snapshotMenu = new QMenu(snapshotButton_);
+  snapshotMenu->addAction(tr("Save..."), this, SLOT(saveSnapshotAs()));
+  snapshotMenu->addAction(tr("Open..."), this, SLOT(openSnapshot()));
+  snapshotMenu->addAction(tr("Compare with..."), this,
+                          SLOT(compareWithSnapshot()));
+  stopComparison_ = snapshotMenu->addAction(tr("Stop comparison"), this,
+                                            SLOT(stopComparison()));
+  stopComparison_->setEnabled(false);
+  snapshotButton_->setMenu(snapshotMenu);
+  snapshotButton_->setToolTip(
+      "Save or open the graph and its statistics, or compare the statistics "
+      "with those of a snapshot: green elements improved, red ones "
+      "regressed.");
+  buttonBox_->layout()->addWidget(snapshotButton_);
+  regressions_->setToolTip(
+      "Elements whose success rate dropped the most since the snapshot, "
+      "then those with the most new errors. Click to show one.");
+  regressions_->hide();
+  addInfoWidget(regressions_);
+#if (QT_VERSION >= QT_VERSION_CHECK(4, 7, 0))
+  searchBox_->setPlaceholderText("Search");
+#endif
+  searchBox_->setToolTip(
+      "Select the nodes and edges whose name, containing node or constraints "
+      "contain the words. Conditions such as \"rate < 20%\", \"weight == "
+      "0\", \"freq > 10\" or \"obs < 20\" filter on the statistics. Press "
+      "Enter to zoom on the results.");
+  buttonBox_->layout()->addWidget(searchBox_);
+  instanceBox_->setToolTip(
+      "Statistics of the servers solving the same problem: their sum or "
+      "those of one server.");
+  instanceBox_->setVisible(false);
+  buttonBox_->layout()->addWidget(instanceBox_);
+  unreachable_->setStyleSheet("QLabel { color: white; background: red; }");
+  unreachable_->setToolTip(
+      "The last calls to the server failed. The calls fail at once until the "
+      "server answers again.");
+  unreachable_->setVisible(!CircuitBreaker::instance().reachable());
+  buttonBox_->layout()->addWidget(unreachable_);
+  stale_->setStyleSheet("QLabel { background: yellow; }");
+  stale_->setToolTip(
+      "The graph and the statistics come from a snapshot or from a previous "
+      "connection. They are updated once connected to the server.");
+  stale_->setVisible(false);
+  buttonBox_->layout()->addWidget(stale_);
+  QAction* focusSelection = new QAction("Focus on selection", this);
+  focusSelection->setShortcut(Qt::Key_F);
+  focusSelection->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+  connect(focusSelection, SIGNAL(triggered()), SLOT(focusOnSelection()));
+  addAction(focusSelection);
+  QAction* undo = undoStack_->createUndoAction(this);
+  undo->setShortcut(QKeySequence::Undo);
+  undo->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+  addAction(undo);
+  QAction* redo = undoStack_->createRedoAction(this);
+  redo->setShortcut(QKeySequence::Redo);
+  redo->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+  addAction(redo);
   updateStatsTimer_->setInterval(1000);
   updateStatsTimer_->setSingleShot(false);
 
   connect(updateStatsTimer_, SIGNAL(timeout()), SLOT(updateStatistics()));
   connect(statButton_, SIGNAL(clicked(bool)), SLOT(startStopUpdateStats(bool)));
+  connect(weightsButton_, SIGNAL(clicked()), SLOT(editSelectedWeights()));
+  connect(tuneButton_, SIGNAL(clicked(bool)), SLOT(startStopTuning(bool)));
+  connect(tuneTimer_, SIGNAL(timeout()), SLOT(tuneWeights()));
+  connect(focusButton_, SIGNAL(clicked(bool)), SLOT(toggleFocus(bool)));
+  connect(focusHops_, SIGNAL(valueChanged(int)), SLOT(setFocusHops(int)));
+  connect(searchBox_, SIGNAL(textChanged(QString)), SLOT(search(QString)));
+  connect(searchBox_, SIGNAL(returnPressed()), SLOT(zoomToResults()));
+  reconciling_ = new QFutureWatcher<Reconciliation>(this);
+  reconcileClient_ = NULL;
+  connect(reconciling_, SIGNAL(finished()), SLOT(reconciled()));
+  connect(instanceBox_, SIGNAL(currentIndexChanged(int)),
+          SLOT(instanceChanged(int)));
+  connect(clusterMode_, SIGNAL(currentIndexChanged(int)),
+          SLOT(clusterModeChanged(int)));
+  connect(scene_, SIGNAL(subGraphDoubleClick(QGVSubGraph*)),
+          SLOT(subGraphDoubleClick(QGVSubGraph*)));
   connect(scene_, SIGNAL(selectionChanged()), SLOT(selectionChanged()));
+  connect(regressions_, SIGNAL(itemClicked(QListWidgetItem*)),
+          SLOT(regressionActivated(QListWidgetItem*)));
+  // The breaker may change from any thread.
+  connect(&CircuitBreaker::instance(), SIGNAL(reachableChanged(bool)),
+          SLOT(serverReachable(bool)), Qt::QueuedConnection);
 }
 
 HppManipulationGraphWidget::~HppManipulationGraphWidget() {
+  reconciling_->waitForFinished();
+  instances_.append(retired_);
+  foreach (Instance* instance, instances_) {
+    instance->poll->waitForFinished();
+    delete instance->client;
+    delete instance;
+  }
   qDeleteAll(nodeContextMenuActions_);
   qDeleteAll(edgeContextMenuActions_);
   delete updateStatsTimer_;
@@ -116,7 +684,90 @@ void HppManipulationGraphWidget::addEdgeContextMenuAction(GraphAction* action) {
 
 void HppManipulationGraphWidget::client(
     corbaServer::manipulation::Client* hpp) {
+  // The result of a running reconcile is dropped. Its client is still
+  // alive: the caller deletes the previous client after this call.
+  reconciling_->waitForFinished();
+  reconcileClient_ = NULL;
   manip_ = hpp;
+  if (manip_ == NULL) {
+    // Keep showing the graph, until the next server tells whether it is
+    // the same.
+    if (cache_.valid) stale_->show();
+    return;
+  }
+  // isVisible is false until the window is shown.
+  if (!stale_->isHidden() && cache_.valid) {
+    reconcile();
+    return;
+  }
+  cache_.valid = false;
+  updateGraph();
+}
+
+void HppManipulationGraphWidget::reconcile() {
+  QList< ::hpp::ID> edges;
+  foreach (const GraphCache::Edge& edge, cache_.edges) edges.append(edge.id);
+  reconcileClient_ = manip_;
+  reconciling_->setFuture(
+      QtConcurrent::run(&HppManipulationGraphWidget::fetchWeights, manip_,
+                        cache_.revision, edges));
+}
+
+HppManipulationGraphWidget::Reconciliation
+HppManipulationGraphWidget::fetchWeights(
+    corbaServer::manipulation::Client* client, QByteArray revision,
+    QList< ::hpp::ID> edges) {
+  HPP_PLOT_TRACE("fetchWeights");
+  Reconciliation r;
+  try {
+    hpp::GraphComp_var graph = new hpp::GraphComp;
+    hpp::GraphElements_var elmts = new hpp::GraphElements;
+    HPP_PLOT_CALL("graph.getGraph",
+                  client->graph()->getGraph(graph.out(), elmts.out()));
+    r.revision = graphRevision(graph.in(), elmts.in());
+    if (r.revision != revision) return r;
+    // The weights are the only attributes that change without changing
+    // the revision.
+    foreach (::hpp::ID id, edges)
+      r.weights[id] =
+          HPP_PLOT_CALL("graph.getWeight", client->graph()->getWeight(id));
+  } catch (const CORBA::Exception& e) {
+    r.error = errorMessage(e);
+  }
+  return r;
+}
+
+void HppManipulationGraphWidget::reconciled() {
+  // The client changed or the graph was fetched meanwhile.
+  if (reconcileClient_ == NULL || reconcileClient_ != manip_ ||
+      stale_->isHidden())
+    return;
+  reconcileClient_ = NULL;
+  Reconciliation r = reconciling_->result();
+  if (!r.error.isEmpty())
+    qDebug() << "HppManipulationGraphWidget::reconcile" << r.error;
+  if (!r.error.isEmpty() || r.revision != cache_.revision) {
+    cache_.valid = false;
+    updateGraph();
+    return;
+  }
+  // The edges that are not drawn, like the waypoint transitions, are in the
+  // cache too.
+  for (int i = 0; i < cache_.edges.size(); ++i) {
+    GraphCache::Edge& edge = cache_.edges[i];
+    if (!r.weights.contains(edge.id)) continue;
+    edge.weight = r.weights[edge.id];
+    if (!edges_.contains(edge.id)) continue;
+    EdgeInfo& ei = edgeInfos_[edges_[edge.id]];
+    if (ei.id != edge.id) continue;
+    ei.weight = edge.weight;
+    updateWeight(ei, false);
+    updateStyle(ei.edge);
+  }
+  view()->invalidateLod();
+  scene_->update();
+  stale_->hide();
+  updateStatistics();
 }
 
 bool hpp::plot::HppManipulationGraphWidget::selectionID(ID& id) {
@@ -124,215 +775,1134 @@ bool hpp::plot::HppManipulationGraphWidget::selectionID(ID& id) {
   return currentId_ != -1;
 }
 
-void HppManipulationGraphWidget::fillScene() {
-  if (manip_ == NULL) return;
+void HppManipulationGraphWidget::fetchGraph() {
+  cache_ = GraphCache();
   hpp::GraphComp_var graph = new hpp::GraphComp;
   hpp::GraphElements_var elmts = new hpp::GraphElements;
   try {
-    manip_->graph()->getGraph(graph.out(), elmts.out());
+    HPP_PLOT_CALL("graph.getGraph",
+                  manip_->graph()->getGraph(graph.out(), elmts.out()));
+    HPP_PLOT_CALL_BYTES("graph.getGraph",
+                        (elmts->nodes.length() + elmts->edges.length()) *
+                            sizeof(hpp::GraphElement));
+    cache_.revision = graphRevision(graph.in(), elmts.in());
 
     graphName_ = graph->name;
-    scene_->setGraphAttribute("label", QString(graph->name));
-
-    scene_->setGraphAttribute("splines", "spline");
-    // scene_->setGraphAttribute("rankdir", "LR");
-    scene_->setGraphAttribute("outputorder", "edgesfirst");
-    scene_->setGraphAttribute("nodesep", "0.5");
-    scene_->setGraphAttribute("esep", "0.8");
-    scene_->setGraphAttribute("sep", "1");
-
-    scene_->setNodeAttribute("shape", "circle");
-    scene_->setNodeAttribute("style", "filled");
-    scene_->setNodeAttribute("fillcolor", "white");
-    // scene_->setNodeAttribute("height", "1.2");
-    // scene_->setEdgeAttribute("minlen", "3");
-
     graphInfo_.id = graph->id;
     graphInfo_.constraintStr = getConstraints(graphInfo_.id);
 
-    // Add the nodes
-    nodes_.clear();
-    edges_.clear();
-    bool hideW = !showWaypoints_->isChecked();
-    QMap<hpp::ID, bool> nodeIsWaypoint;
-    QMap<hpp::ID, bool> edgeVisible;
-
-    // initialize node counters.
-    for (std::size_t i = 0; i < elmts->nodes.length(); ++i) {
-      if (elmts->nodes[(CORBA::ULong)i].id > graph->id) {
-        ::hpp::ID id = elmts->nodes[(CORBA::ULong)i].id;
-        nodeIsWaypoint[id] = false;
+    QSet<hpp::ID> waypoints;
+    for (CORBA::ULong i = 0; i < elmts->edges.length(); ++i) {
+      const hpp::GraphElement& elmt = elmts->edges[i];
+      if (elmt.id <= graph->id) continue;
+      GraphCache::Edge edge;
+      edge.id = elmt.id;
+      edge.start = elmt.start;
+      edge.end = elmt.end;
+      edge.name = QString::fromLocal8Bit(elmt.name);
+      for (CORBA::ULong k = 0; k < elmt.waypoints.length(); ++k) {
+        edge.waypoints.append(elmt.waypoints[k]);
+        waypoints.insert(elmt.waypoints[k]);
       }
+      edge.weight = HPP_PLOT_CALL("graph.getWeight",
+                                  manip_->graph()->getWeight(edge.id));
+      CORBA::String_var cnname =
+          HPP_PLOT_CALL("graph.getContainingNode",
+                        manip_->graph()->getContainingNode(edge.id));
+      edge.containingNodeName = QString::fromLocal8Bit((char*)cnname);
+      if (!edge.waypoints.isEmpty()) {
+        edge.constraintStr =
+            tr("<p><h4>Waypoint transition</h4>"
+               "This transition has %1 waypoints.<br/>"
+               "To see the constraints of the transition inside,<br/>"
+               "re-draw the graph after enabling \"Show waypoints\"</p>")
+                .arg(edge.waypoints.size());
+      } else {
+        edge.constraints = getConstraintNames(edge.id);
+        edge.constraintStr = formatConstraints(edge.constraints);
+        if (HPP_PLOT_CALL("graph.isShort", manip_->graph()->isShort(edge.id)))
+          edge.shortStr = "<h4>Short</h4>";
+      }
+      cache_.edgeIndex[edge.id] = cache_.edges.size();
+      cache_.edges.append(edge);
     }
 
-    // Find what edge are visible and count the nodes accordingly.
-    for (std::size_t i = 0; i < elmts->edges.length(); ++i) {
-      if (elmts->edges[(CORBA::ULong)i].id > graph->id) {
-        ::hpp::ID id = elmts->edges[(CORBA::ULong)i].id;
-        ::CORBA::Long weight = manip_->graph()->getWeight(id);
+    for (CORBA::ULong i = 0; i < elmts->nodes.length(); ++i) {
+      const hpp::GraphElement& elmt = elmts->nodes[i];
+      if (elmt.id <= graph->id) continue;
+      GraphCache::Node node;
+      node.id = elmt.id;
+      node.name = QString(elmt.name);
+      node.isWaypoint = waypoints.contains(node.id);
+      node.constraints = getConstraintNames(node.id);
+      node.constraintStr = formatConstraints(node.constraints);
+      cache_.nodeIndex[node.id] = cache_.nodes.size();
+      cache_.nodes.append(node);
+    }
+    cache_.valid = true;
+    stale_->hide();
+  } catch (const CORBA::Exception& e) {
+    qDebug() << "HppManipulationGraphWidget::fetchGraph" << errorMessage(e);
+  }
+  buildSearchIndex();
+}
+
+void HppManipulationGraphWidget::buildSearchIndex() {
+  HPP_PLOT_TRACE("buildSearchIndex");
+  searchIndex_.clear();
+  searchIds_.clear();
+  foreach (const GraphCache::Node& node, cache_.nodes) {
+    searchIndex_.add(QStringList(node.name) << node.constraints);
+    searchIds_.append(node.id);
+  }
+  foreach (const GraphCache::Edge& edge, cache_.edges) {
+    searchIndex_.add(QStringList(edge.name)
+                     << edge.containingNodeName << edge.constraints);
+    searchIds_.append(edge.id);
+  }
+}
 
-        for (std::size_t k = 0;
-             k < elmts->edges[(CORBA::ULong)i].waypoints.length(); ++k)
-          nodeIsWaypoint[elmts->edges[(CORBA::ULong)i]
-                             .waypoints[(CORBA::ULong)k]] = true;
+void HppManipulationGraphWidget::search(const QString& query) {
+  HPP_PLOT_TRACE("search");
+  QString text(query);
+  QList<SearchFilter> filters = SearchFilter::extract(text, filterFields());
+  const double none = std::numeric_limits<double>::quiet_NaN();
 
-        bool hasWaypoints =
-            elmts->edges[(CORBA::ULong)i].waypoints.length() > 0;
-        // If    show Waypoint and this is not a waypoint edge
-        //    or hide Waypoint and this is not a transition inside a
-        //    WaypointEdge
-        edgeVisible[id] = (!hideW && !hasWaypoints) || (hideW && weight >= 0);
+  // Emit selectionChanged once, instead of once per item.
+  scene_->blockSignals(true);
+  scene_->clearSelection();
+  if (!text.trimmed().isEmpty() || !filters.isEmpty()) {
+    foreach (int doc, searchIndex_.find(text)) {
+      hpp::ID id = searchIds_[doc];
+      if (nodes_.contains(id)) {
+        const NodeInfo& ni = nodeInfos_[nodes_[id]];
+        if (acceptFilters(filters, ni.configStat, none, ni.freq))
+          ni.node->setSelected(true);
+      } else if (edges_.contains(id)) {
+        const EdgeInfo& ei = edgeInfos_[edges_[id]];
+        if (acceptFilters(filters, ei.configStat, ei.weight, none))
+          ei.edge->setSelected(true);
       }
     }
+  }
+  scene_->blockSignals(false);
+  selectionChanged();
+}
 
-    for (std::size_t i = 0; i < elmts->nodes.length(); ++i) {
-      if (elmts->nodes[(CORBA::ULong)i].id > graph->id) {
-        Q_ASSERT(nodeIsWaypoint.contains(elmts->nodes[(CORBA::ULong)i].id));
+void HppManipulationGraphWidget::serverReachable(bool reachable) {
+  unreachable_->setVisible(!reachable);
+  // Get the graph that could not be fetched.
+  if (reachable && !cache_.valid) updateGraph();
+}
 
-        if (hideW && nodeIsWaypoint[elmts->nodes[(CORBA::ULong)i].id]) {
-          qDebug() << "Ignoring node" << elmts->nodes[(CORBA::ULong)i].name;
-          continue;
+void HppManipulationGraphWidget::zoomToResults() {
+  search(searchBox_->text());
+  QRectF rect;
+  foreach (QGraphicsItem* item, scene_->selectedItems())
+    rect |= item->sceneBoundingRect();
+  if (rect.isEmpty()) return;
+  view()->fitInView(rect.adjusted(-50, -50, 50, 50), Qt::KeepAspectRatio);
+  view()->updateLevelOfDetail();
+  view()->invalidateLod();
+}
+
+bool HppManipulationGraphWidget::edgeVisible(
+    const GraphCache::Edge& edge) const {
+  bool hideW = !showWaypoints_->isChecked();
+  // If    show Waypoint and this is not a waypoint edge
+  //    or hide Waypoint and this is not a transition inside a
+  //    WaypointEdge
+  return (!hideW && edge.waypoints.isEmpty()) || (hideW && edge.weight >= 0);
+}
+
+QSet<hpp::ID> HppManipulationGraphWidget::focusNodes() const {
+  QSet<hpp::ID> visited;
+  QList<hpp::ID> current;
+  if (cache_.edgeIndex.contains(focusId_)) {
+    const GraphCache::Edge& edge = cache_.edges[cache_.edgeIndex[focusId_]];
+    current << edge.start << edge.end;
+  } else
+    current << focusId_;
+  visited = current.toSet();
+
+  QMultiMap<hpp::ID, hpp::ID> neighbors;
+  foreach (const GraphCache::Edge& edge, cache_.edges) {
+    if (!edgeVisible(edge)) continue;
+    neighbors.insert(edge.start, edge.end);
+    neighbors.insert(edge.end, edge.start);
+  }
+  // Breadth first search, ignoring the direction of the edges.
+  for (int hop = 0; hop < focusHops_->value() && !current.isEmpty(); ++hop) {
+    QList<hpp::ID> next;
+    foreach (hpp::ID id, current) {
+      foreach (hpp::ID n, neighbors.values(id)) {
+        if (visited.contains(n)) continue;
+        visited.insert(n);
+        next.append(n);
+      }
+    }
+    current = next;
+  }
+  return visited;
+}
+
+QMap<hpp::ID, QString> HppManipulationGraphWidget::clusters(
+    const QSet<hpp::ID>& nodes) const {
+  QMap<hpp::ID, QString> clusterOf;
+  switch (clusterMode()) {
+    case ClusterByPrefix:
+      foreach (hpp::ID id, nodes)
+        clusterOf[id] =
+            cache_.nodes[cache_.nodeIndex[id]].name.section(" : ", 0, 0);
+      break;
+    case ClusterByWaypoints:
+      foreach (const GraphCache::Edge& edge, cache_.edges) {
+        foreach (hpp::ID id, edge.waypoints) {
+          if (nodes.contains(id)) clusterOf[id] = edge.name;
         }
-        QString nodeName(elmts->nodes[(CORBA::ULong)i].name);
-        nodeName.replace(" : ", "\n");
-        QGVNode* n = scene_->addNode(nodeName);
-        if (i == 0) scene_->setRootNode(n);
+      }
+      break;
+    case ClusterByComponent: {
+      QMap<hpp::ID, hpp::ID> parent;
+      foreach (hpp::ID id, nodes) parent[id] = id;
+      foreach (const GraphCache::Edge& edge, cache_.edges) {
+        if (!edgeVisible(edge) || !parent.contains(edge.start) ||
+            !parent.contains(edge.end))
+          continue;
+        hpp::ID a = findRoot(parent, edge.start);
+        hpp::ID b = findRoot(parent, edge.end);
+        if (a != b) parent[b] = a;
+      }
+      // Number the components in the order of the nodes.
+      QMap<hpp::ID, QString> names;
+      foreach (const GraphCache::Node& node, cache_.nodes) {
+        if (!parent.contains(node.id)) continue;
+        hpp::ID root = findRoot(parent, node.id);
+        if (!names.contains(root))
+          names[root] = tr("Component %1").arg(names.size() + 1);
+        clusterOf[node.id] = names[root];
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  QMap<QString, int> sizes;
+  foreach (const QString& cluster, clusterOf) ++sizes[cluster];
+  QMap<hpp::ID, QString>::iterator it = clusterOf.begin();
+  while (it != clusterOf.end()) {
+    if (sizes[*it] < 2)
+      it = clusterOf.erase(it);
+    else
+      ++it;
+  }
+  return clusterOf;
+}
+
+void HppManipulationGraphWidget::fillScene() {
+  // Without server, the cache can still be drawn.
+  if (manip_ == NULL && !(useCache_ && cache_.valid)) return;
+  if (!useCache_ || !cache_.valid) fetchGraph();
+  if (!cache_.valid) return;
+
+  scene_->setGraphAttribute("label", QString::fromStdString(graphName_));
+
+  scene_->setGraphAttribute("splines", "spline");
+  // scene_->setGraphAttribute("rankdir", "LR");
+  scene_->setGraphAttribute("outputorder", "edgesfirst");
+  scene_->setGraphAttribute("nodesep", "0.5");
+  scene_->setGraphAttribute("esep", "0.8");
+  scene_->setGraphAttribute("sep", "1");
+
+  scene_->setNodeAttribute("shape", "circle");
+  scene_->setNodeAttribute("style", "filled");
+  scene_->setNodeAttribute("fillcolor", "white");
+  // scene_->setNodeAttribute("height", "1.2");
+  // scene_->setEdgeAttribute("minlen", "3");
+
+  // Add the nodes
+  nodes_.clear();
+  edges_.clear();
+  nodeInfos_.clear();
+  edgeInfos_.clear();
+  subGraphs_.clear();
+  bool hideW = !showWaypoints_->isChecked();
+  // The focused element may not exist anymore.
+  if (focused() && !cache_.nodeIndex.contains(focusId_) &&
+      !cache_.edgeIndex.contains(focusId_)) {
+    focusId_ = -1;
+    focusButton_->setChecked(false);
+  }
+  bool focus = focused();
+  QSet<hpp::ID> shown;
+  if (focus) shown = focusNodes();
+
+  QList<int> visible;
+  QSet<hpp::ID> visibleIds;
+  for (int i = 0; i < cache_.nodes.size(); ++i) {
+    const GraphCache::Node& node = cache_.nodes[i];
+    if (focus && !shown.contains(node.id)) continue;
+    if (hideW && node.isWaypoint) {
+      qDebug() << "Ignoring node" << node.name;
+      continue;
+    }
+    visible.append(i);
+    visibleIds.insert(node.id);
+  }
+  QMap<hpp::ID, QString> clusterOf = clusters(visibleIds);
+  QMap<QString, int> clusterSizes;
+  foreach (const QString& cluster, clusterOf) ++clusterSizes[cluster];
+  QMap<QString, QGVNode*> collapsed;
+  QMap<QString, QGVSubGraph*> subGraphs;
+
+  foreach (int i, visible) {
+    const GraphCache::Node& node = cache_.nodes[i];
+    bool root = focus ? node.id == focusId_ : i == 0;
+    QString cluster = clusterOf.value(node.id);
+    if (!cluster.isNull() && !expanded_.contains(cluster)) {
+      // All the nodes of a collapsed cluster map to a single node.
+      QGVNode*& n = collapsed[cluster];
+      if (n == NULL) {
+        n = scene_->addNode(tr("%1\n(%2 states)")
+                                .arg(cluster)
+                                .arg(clusterSizes[cluster]));
+        n->setAttribute("shape", "box");
+        n->setFlag(QGraphicsItem::ItemIsMovable, true);
+        n->setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
         NodeInfo ni;
-        ni.id = elmts->nodes[(CORBA::ULong)i].id;
         ni.node = n;
-        ni.constraintStr = getConstraints(ni.id);
+        ni.cluster = cluster;
+        ni.constraintStr =
+            tr("<p><h4>Collapsed cluster</h4>Double click to expand it.</p>");
         nodeInfos_[n] = ni;
-        n->setFlag(QGraphicsItem::ItemIsMovable, true);
-        n->setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
-        nodes_[elmts->nodes[(CORBA::ULong)i].id] = n;
+      }
+      if (root) scene_->setRootNode(n);
+      nodeInfos_[n].members.append(node.id);
+      nodes_[node.id] = n;
+      continue;
+    }
 
-        if (nodeIsWaypoint[ni.id]) n->setAttribute("shape", "hexagon");
+    QString nodeName(node.name);
+    nodeName.replace(" : ", "\n");
+    QGVNode* n;
+    if (cluster.isNull()) {
+      n = scene_->addNode(nodeName);
+    } else {
+      QGVSubGraph*& sg = subGraphs[cluster];
+      if (sg == NULL) {
+        sg = scene_->addSubGraph(cluster);
+        sg->setAttribute("label", cluster);
+        subGraphs_[sg] = cluster;
       }
+      n = sg->addNode(nodeName);
     }
-    for (std::size_t i = 0; i < elmts->edges.length(); ++i) {
-      if (elmts->edges[(CORBA::ULong)i].id > graph->id) {
-        Q_ASSERT(edgeVisible.contains(elmts->edges[(CORBA::ULong)i].id) &&
-                 nodeIsWaypoint.contains(elmts->edges[(CORBA::ULong)i].start) &&
-                 nodeIsWaypoint.contains(elmts->edges[(CORBA::ULong)i].end));
-        if (!edgeVisible[elmts->edges[(CORBA::ULong)i].id]) {
-          qDebug() << "Ignoring edge" << elmts->edges[(CORBA::ULong)i].name;
-          continue;
-        }
+    if (root) scene_->setRootNode(n);
+    if (snapshotPos_.contains(node.id)) n->setPos(snapshotPos_[node.id]);
+    NodeInfo ni;
+    ni.id = node.id;
+    ni.node = n;
+    ni.constraintStr = node.constraintStr;
+    ni.cluster = cluster;
+    nodeInfos_[n] = ni;
+    n->setFlag(QGraphicsItem::ItemIsMovable, true);
+    n->setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+    nodes_[node.id] = n;
+
+    if (node.isWaypoint) n->setAttribute("shape", "hexagon");
+  }
+  QMap<QPair<QGVNode*, QGVNode*>, QGVEdge*> merged;
+  foreach (const GraphCache::Edge& edge, cache_.edges) {
+    if (!edgeVisible(edge)) {
+      qDebug() << "Ignoring edge" << edge.name;
+      continue;
+    }
+    if (!nodes_.contains(edge.start) || !nodes_.contains(edge.end)) continue;
+    QGVNode *start = nodes_[edge.start], *end = nodes_[edge.end];
+    if (!nodeInfos_[start].members.isEmpty() ||
+        !nodeInfos_[end].members.isEmpty()) {
+      // The edges inside a collapsed cluster are not drawn. The others are
+      // merged when they have the same ends.
+      if (start == end) continue;
+      QGVEdge*& e = merged[qMakePair(start, end)];
+      if (e == NULL) {
+        e = addEdge(start, end, "");
         EdgeInfo ei;
-        QGVEdge* e =
-            scene_->addEdge(nodes_[elmts->edges[(CORBA::ULong)i].start],
-                            nodes_[elmts->edges[(CORBA::ULong)i].end], "");
-        ei.name = QString::fromLocal8Bit(elmts->edges[(CORBA::ULong)i].name);
-        ei.id = elmts->edges[(CORBA::ULong)i].id;
-        CORBA::String_var cnname = manip_->graph()->getContainingNode(ei.id);
-        ei.containingNodeName = QString::fromLocal8Bit((char*)cnname);
+        ei.start = edge.start;
+        ei.end = edge.end;
         ei.edge = e;
-        updateWeight(ei, true);
-
-        if (elmts->edges[(CORBA::ULong)i].waypoints.length() > 0) {
-          ei.constraintStr =
-              tr("<p><h4>Waypoint transition</h4>"
-                 "This transition has %1 waypoints.<br/>"
-                 "To see the constraints of the transition inside,<br/>"
-                 "re-draw the graph after enabling \"Show waypoints\"</p>")
-                  .arg(elmts->edges[(CORBA::ULong)i].waypoints.length());
-          ei.shortStr = "";
-        } else {
-          ei.constraintStr = getConstraints(ei.id);
+        ei.weight = 1;
+        updateWeight(ei, false);
+        edgeInfos_[e] = ei;
+      }
+      edgeInfos_[e].members.append(edge.id);
+      continue;
+    }
+    EdgeInfo ei;
+    QGVEdge* e = addEdge(start, end, "");
+    ei.name = edge.name;
+    ei.id = edge.id;
+    ei.start = edge.start;
+    ei.end = edge.end;
+    ei.containingNodeName = edge.containingNodeName;
+    ei.edge = e;
+    ei.weight = edge.weight;
+    updateWeight(ei, false);
+    ei.constraintStr = edge.constraintStr;
+    ei.shortStr = edge.shortStr;
 
-          if (manip_->graph()->isShort(ei.id)) ei.shortStr = "<h4>Short</h4>";
-        }
+    // If this is a transition inside a WaypointEdge
+    if (ei.weight < 0) {
+      e->setAttribute("weight", "3");
+      if (edge.start >= edge.end) e->setAttribute("constraint", "false");
+    }
 
-        // If this is a transition inside a WaypointEdge
-        if (ei.weight < 0) {
-          e->setAttribute("weight", "3");
-          if (elmts->edges[(CORBA::ULong)i].start >=
-              elmts->edges[(CORBA::ULong)i].end)
-            e->setAttribute("constraint", "false");
-        }
+    edgeInfos_[e] = ei;
+    edges_[ei.id] = e;
+  }
+  foreach (QGVEdge* e, merged) {
+    EdgeInfo& ei = edgeInfos_[e];
+    ei.name = tr("%1 transitions").arg(ei.members.size());
+    if (ei.members.size() > 1) e->setLabel(QString::number(ei.members.size()));
+  }
+}
 
-        edgeInfos_[e] = ei;
-        edges_[ei.id] = e;
-      }
+void HppManipulationGraphWidget::focusOn(hpp::ID id, int hops) {
+  focusId_ = id;
+  focusHops_->blockSignals(true);
+  focusHops_->setValue(hops);
+  focusHops_->blockSignals(false);
+  focusButton_->setChecked(true);
+  redraw();
+}
+
+void HppManipulationGraphWidget::clearFocus() {
+  focusId_ = -1;
+  focusButton_->setChecked(false);
+  redraw();
+}
+
+void HppManipulationGraphWidget::redraw() {
+  useCache_ = true;
+  updateGraph();
+  useCache_ = false;
+}
+
+bool HppManipulationGraphWidget::saveSnapshot(const QString& filename) const {
+  HPP_PLOT_TRACE("saveSnapshot");
+  if (!cache_.valid) return false;
+  QByteArray bytes;
+  {
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << QString::fromStdString(graphName_) << (qint64)graphInfo_.id
+        << graphInfo_.constraintStr << cache_.revision;
+    out << (qint32)cache_.nodes.size();
+    foreach (const GraphCache::Node& n, cache_.nodes)
+      out << (qint64)n.id << n.name << n.constraintStr << n.constraints
+          << n.isWaypoint;
+    out << (qint32)cache_.edges.size();
+    foreach (const GraphCache::Edge& e, cache_.edges) {
+      out << (qint64)e.id << (qint64)e.start << (qint64)e.end << e.name
+          << e.containingNodeName << e.constraintStr << e.shortStr
+          << e.constraints << (qint32)e.weight << (qint32)e.waypoints.size();
+      foreach (hpp::ID w, e.waypoints) out << (qint64)w;
+    }
+
+    // The clusters are not saved: they are computed again.
+    QList<const NodeInfo*> nodes;
+    foreach (const NodeInfo& ni, nodeInfos_)
+      if (ni.id >= 0) nodes.append(&ni);
+    out << (qint32)nodes.size();
+    foreach (const NodeInfo* ni, nodes) {
+      out << (qint64)ni->id << ni->node->pos();
+      writeStat(out, ni->configStat);
+      writeStat(out, ni->pathStat);
+      out << (qint32)ni->freq;
+      writeSeq(out, ni->freqPerCC.in());
     }
-  } catch (const hpp::Error& e) {
-    qDebug() << e.msg;
+    QList<const EdgeInfo*> edges;
+    foreach (const EdgeInfo& ei, edgeInfos_)
+      if (ei.id >= 0) edges.append(&ei);
+    out << (qint32)edges.size();
+    foreach (const EdgeInfo* ei, edges) {
+      out << (qint64)ei->id;
+      writeStat(out, ei->configStat);
+      writeStat(out, ei->pathStat);
+      writeNames(out, ei->errors.in());
+      writeSeq(out, ei->freqs.in());
+    }
+  }
+
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) return false;
+  QDataStream out(&file);
+  out << SnapshotMagic << SnapshotVersion << qCompress(bytes);
+  return out.status() == QDataStream::Ok;
+}
+
+bool HppManipulationGraphWidget::readSnapshot(const QString& filename,
+                                              Snapshot& snapshot) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+  QByteArray bytes;
+  {
+    QDataStream in(&file);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != SnapshotMagic ||
+        version != SnapshotVersion)
+      return false;
+    in >> bytes;
+    bytes = qUncompress(bytes);
+    if (bytes.isEmpty()) return false;
+  }
+
+  QDataStream in(&bytes, QIODevice::ReadOnly);
+  in.setVersion(QDataStream::Qt_4_6);
+  GraphCache& cache = snapshot.cache;
+  qint64 graphId, id, start, end;
+  qint32 count, weight, nbWaypoints, freq;
+  in >> snapshot.graphName >> graphId >> snapshot.constraintStr >>
+      cache.revision;
+  snapshot.graphId = (hpp::ID)graphId;
+  in >> count;
+  for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+    GraphCache::Node n;
+    in >> id >> n.name >> n.constraintStr >> n.constraints >> n.isWaypoint;
+    n.id = (hpp::ID)id;
+    cache.nodeIndex[n.id] = cache.nodes.size();
+    cache.nodes.append(n);
+  }
+  in >> count;
+  for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+    GraphCache::Edge e;
+    in >> id >> start >> end >> e.name >> e.containingNodeName >>
+        e.constraintStr >> e.shortStr >> e.constraints >> weight >>
+        nbWaypoints;
+    e.id = (hpp::ID)id;
+    e.start = (hpp::ID)start;
+    e.end = (hpp::ID)end;
+    e.weight = weight;
+    for (qint32 k = 0; k < nbWaypoints && in.status() == QDataStream::Ok;
+         ++k) {
+      in >> id;
+      e.waypoints.append((hpp::ID)id);
+    }
+    cache.edgeIndex[e.id] = cache.edges.size();
+    cache.edges.append(e);
+  }
+
+  in >> count;
+  for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+    QPointF pos;
+    in >> id >> pos;
+    snapshot.positions[(hpp::ID)id] = pos;
+    PolledStats::Node& n = snapshot.stats.nodes[(hpp::ID)id];
+    readStat(in, n.configStat);
+    readStat(in, n.pathStat);
+    in >> freq;
+    n.freq = freq;
+    readSeq(in, n.freqPerCC);
+  }
+  in >> count;
+  for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+    in >> id;
+    PolledStats::Edge& e = snapshot.stats.edges[(hpp::ID)id];
+    readStat(in, e.configStat);
+    readStat(in, e.pathStat);
+    in >> e.errors;
+    readSeq(in, e.freqs);
   }
+  if (in.status() != QDataStream::Ok) return false;
+  cache.valid = true;
+  return true;
+}
+
+bool HppManipulationGraphWidget::loadSnapshot(const QString& filename) {
+  HPP_PLOT_TRACE("loadSnapshot");
+  Snapshot snapshot;
+  if (!readSnapshot(filename, snapshot)) return false;
+  cache_ = snapshot.cache;
+  graphName_ = snapshot.graphName.toStdString();
+  graphInfo_.id = snapshot.graphId;
+  graphInfo_.constraintStr = snapshot.constraintStr;
+  buildSearchIndex();
+
+  // Without the position of every shown node, lay the graph out again.
+  bool positioned = true;
+  foreach (const GraphCache::Node& n, cache_.nodes)
+    if (!n.isWaypoint && !snapshot.positions.contains(n.id))
+      positioned = false;
+  snapshotPos_ = snapshot.positions;
+  useCache_ = true;
+  if (positioned)
+    layoutGraph("nop2");
+  else
+    updateGraph();
+  useCache_ = false;
+  snapshotPos_.clear();
+
+  applyStatistics(snapshot.stats);
+  stale_->show();
+  return true;
+}
+
+void HppManipulationGraphWidget::setClusterMode(ClusterMode mode) {
+  clusterMode_->setCurrentIndex(mode);
+}
+
+HppManipulationGraphWidget::ClusterMode
+HppManipulationGraphWidget::clusterMode() const {
+  return (ClusterMode)clusterMode_->currentIndex();
+}
+
+void HppManipulationGraphWidget::expandCluster(const QString& cluster) {
+  expanded_.insert(cluster);
+  redraw();
+}
+
+void HppManipulationGraphWidget::collapseCluster(const QString& cluster) {
+  expanded_.remove(cluster);
+  redraw();
+}
+
+void HppManipulationGraphWidget::clusterModeChanged(int) {
+  expanded_.clear();
+  redraw();
+}
+
+void HppManipulationGraphWidget::subGraphDoubleClick(QGVSubGraph* subGraph) {
+  // Copied, as the scene is cleared.
+  QString cluster = subGraphs_.value(subGraph);
+  if (!cluster.isNull()) collapseCluster(cluster);
+}
+
+void HppManipulationGraphWidget::toggleFocus(bool focus) {
+  if (!focus) {
+    clearFocus();
+    return;
+  }
+  hpp::ID id = (currentId_ >= 0) ? currentId_ : showNodeId_;
+  if (id < 0) {
+    focusButton_->setChecked(false);
+    QMessageBox::information(this, "Focus",
+                             "Select a node or an edge to focus on.");
+    return;
+  }
+  focusOn(id, focusHops_->value());
+}
+
+void HppManipulationGraphWidget::focusOnSelection() {
+  if (currentId_ >= 0) focusOn(currentId_, focusHops_->value());
+}
+
+void HppManipulationGraphWidget::setFocusHops(int hops) {
+  if (focused()) focusOn(focusId_, hops);
 }
 
 void HppManipulationGraphWidget::updateStatistics() {
+  HPP_PLOT_TRACE("updateStatistics");
   if (manip_ == NULL) {
     updateStatsTimer_->stop();
     statButton_->setChecked(false);
     return;
   }
+  QList<hpp::ID> nodes, edges, configOnly;
+  foreach (const NodeInfo& ni, nodeInfos_) {
+    if (ni.members.isEmpty())
+      nodes.append(ni.id);
+    else
+      nodes.append(ni.members);
+  }
+  foreach (const EdgeInfo& ei, edgeInfos_) {
+    if (ei.members.isEmpty())
+      edges.append(ei.id);
+    else
+      configOnly.append(ei.members);
+  }
+
+  // The other servers are polled in the background, each in its own
+  // thread: a slow server delays its own statistics only. The last
+  // statistics of each server are shown. shown is -1 for the sum.
+  int shown = qMax(-1, instanceBox_->currentIndex() - 1);
+  for (int i = 0; i < instances_.size(); ++i) {
+    Instance* instance = instances_[i];
+    if ((shown >= 0 && shown != i + 1) || instance->poll->isRunning())
+      continue;
+    if (instance->failing && instance->failure.elapsed() < instance->retryDelay)
+      continue;
+    instance->poll->setFuture(QtConcurrent::run(
+        &HppManipulationGraphWidget::pollStatistics, instance->client, false,
+        nodes, edges, configOnly));
+  }
+  if (shown > 0) return;
+
+  // The main server is polled from this thread, as before.
+  mainStats_ = pollStatistics(manip_, true, nodes, edges, configOnly);
+  if (!mainStats_.error.isEmpty()) {
+    // While the server is unreachable, the calls fail at once and the
+    // polling goes on, to notice when it is back.
+    if (!mainStats_.unreachable) {
+      updateStatsTimer_->stop();
+      statButton_->setChecked(false);
+      qDebug() << "HppManipulationGraphWidget::updateStatistics"
+               << mainStats_.error;
+    }
+    return;
+  }
+  showPolledStatistics();
+}
+
+void HppManipulationGraphWidget::showPolledStatistics() {
+  int shown = qMax(-1, instanceBox_->currentIndex() - 1);
+  if (shown > 0) {
+    if (shown > instances_.size()) return;
+    const PolledStats& stats = instances_[shown - 1]->stats;
+    if (stats.error.isEmpty()) applyStatistics(stats);
+    return;
+  }
+  if (!mainStats_.error.isEmpty()) return;
+  if (shown == 0 || instances_.isEmpty()) {
+    applyStatistics(mainStats_);
+    return;
+  }
+  QList<PolledStats> polled;
+  polled.append(mainStats_);
+  foreach (const Instance* instance, instances_)
+    polled.append(instance->stats);
+  applyStatistics(sumStatistics(polled));
+}
+
+void HppManipulationGraphWidget::applyStatistics(const PolledStats& stats) {
+  for (QMap<QGVNode*, NodeInfo>::iterator it = nodeInfos_.begin();
+       it != nodeInfos_.end(); ++it) {
+    NodeInfo& ni = *it;
+    if (!ni.members.isEmpty()) {
+      aggregateStatistics(ni, stats);
+    } else if (stats.nodes.contains(ni.id)) {
+      const PolledStats::Node& n = stats.nodes[ni.id];
+      ni.configStat = n.configStat;
+      ni.pathStat = n.pathStat;
+      ni.freq = n.freq;
+      ni.freqPerCC = new ::hpp::intSeq();
+      ni.freqPerCC->length((CORBA::ULong)n.freqPerCC.size());
+      for (int k = 0; k < n.freqPerCC.size(); ++k)
+        ni.freqPerCC[(CORBA::ULong)k] = n.freqPerCC[k];
+      ni.ccSummary.clear();
+    }
+    if (!ratesShown_) setColor(ni, statColor(ni.configStat));
+  }
+  for (QMap<QGVEdge*, EdgeInfo>::iterator it = edgeInfos_.begin();
+       it != edgeInfos_.end(); ++it) {
+    EdgeInfo& ei = *it;
+    if (!ei.members.isEmpty()) {
+      aggregateStatistics(ei, stats);
+    } else if (stats.edges.contains(ei.id)) {
+      const PolledStats::Edge& e = stats.edges[ei.id];
+      ei.configStat = e.configStat;
+      ei.pathStat = e.pathStat;
+      ei.errors = new ::hpp::Names_t();
+      ei.errors->length((CORBA::ULong)e.errors.size());
+      for (int k = 0; k < e.errors.size(); ++k)
+        ei.errors[(CORBA::ULong)k] =
+            CORBA::string_dup(e.errors[k].toLocal8Bit().constData());
+      ei.freqs = new ::hpp::intSeq();
+      ei.freqs->length((CORBA::ULong)e.freqs.size());
+      for (int k = 0; k < e.freqs.size(); ++k)
+        ei.freqs[(CORBA::ULong)k] = e.freqs[k];
+    }
+    if (!ratesShown_) setColor(ei, statColor(ei.configStat));
+  }
+  if (comparing()) updateComparison();
+  view()->invalidateLod();
+  scene_->update();
+  selectionChanged();
+}
+
+bool HppManipulationGraphWidget::compareWith(const QString& filename) {
+  HPP_PLOT_TRACE("compareWith");
+  Snapshot snapshot;
+  if (!readSnapshot(filename, snapshot)) return false;
+  baseline_ = snapshot.stats;
+  baselineName_ = QFileInfo(filename).fileName();
+  if (snapshot.cache.revision != cache_.revision)
+    qDebug() << "HppManipulationGraphWidget::compareWith" << filename
+             << "is a snapshot of another graph: only the elements with the "
+                "same ID are compared.";
+  regressions_->show();
+  stopComparison_->setEnabled(true);
+  updateComparison();
+  view()->invalidateLod();
+  scene_->update();
+  return true;
+}
+
+void HppManipulationGraphWidget::stopComparison() {
+  if (!comparing()) return;
+  baseline_ = PolledStats();
+  baselineName_.clear();
+  regressions_->clear();
+  regressions_->hide();
+  stopComparison_->setEnabled(false);
+  if (ratesShown_) return;
+  for (QMap<QGVNode*, NodeInfo>::iterator it = nodeInfos_.begin();
+       it != nodeInfos_.end(); ++it)
+    setColor(*it, statColor(it->configStat));
+  for (QMap<QGVEdge*, EdgeInfo>::iterator it = edgeInfos_.begin();
+       it != edgeInfos_.end(); ++it)
+    setColor(*it, statColor(it->configStat));
+  view()->invalidateLod();
+  scene_->update();
+}
+
+void HppManipulationGraphWidget::updateComparison() {
+  HPP_PLOT_TRACE("updateComparison");
+  // One entry per element shown, elements of collapsed clusters summed.
+  QVector<StatDelta> deltas;
+  deltas.reserve(nodeInfos_.size() + edgeInfos_.size());
+  for (QMap<QGVNode*, NodeInfo>::iterator it = nodeInfos_.begin();
+       it != nodeInfos_.end(); ++it) {
+    NodeInfo& ni = *it;
+    NodeInfo base;
+    if (ni.members.isEmpty()) {
+      if (baseline_.nodes.contains(ni.id)) {
+        base.configStat = baseline_.nodes[ni.id].configStat;
+        base.pathStat = baseline_.nodes[ni.id].pathStat;
+      }
+    } else {
+      base.members = ni.members;
+      aggregateStatistics(base, baseline_);
+    }
+    StatDelta d(ni.id, false, ni.members.isEmpty() ? ni.node->label()
+                                                   : ni.cluster);
+    d.set(base.configStat, base.pathStat, ni.configStat, ni.pathStat);
+    if (!ratesShown_) setColor(ni, d.colorKey());
+    deltas.append(d);
+  }
+  for (QMap<QGVEdge*, EdgeInfo>::iterator it = edgeInfos_.begin();
+       it != edgeInfos_.end(); ++it) {
+    EdgeInfo& ei = *it;
+    EdgeInfo base;
+    if (ei.members.isEmpty()) {
+      if (baseline_.edges.contains(ei.id)) {
+        base.configStat = baseline_.edges[ei.id].configStat;
+        base.pathStat = baseline_.edges[ei.id].pathStat;
+      }
+    } else {
+      base.members = ei.members;
+      aggregateStatistics(base, baseline_);
+    }
+    StatDelta d(ei.id, true, ei.name);
+    d.set(base.configStat, base.pathStat, ei.configStat, ei.pathStat);
+    if (!ratesShown_) setColor(ei, d.colorKey());
+    deltas.append(d);
+  }
+
+  // Only the first entries are shown: partially sort the regressions.
+  QVector<StatDelta>::iterator last =
+      std::partition(deltas.begin(), deltas.end(), isRegression);
+  QVector<StatDelta>::iterator shown =
+      deltas.begin() + std::min(last - deltas.begin(), (ptrdiff_t)50);
+  std::partial_sort(deltas.begin(), shown, last, worseRegression);
+
+  regressions_->setUpdatesEnabled(false);
+  regressions_->clear();
+  regressions_->addItem(tr("%1 regressions since %2")
+                            .arg(last - deltas.begin())
+                            .arg(baselineName_));
+  for (QVector<StatDelta>::iterator d = deltas.begin(); d != shown; ++d) {
+    QListWidgetItem* item = new QListWidgetItem(d->text(), regressions_);
+    item->setData(Qt::UserRole, (qlonglong)d->id);
+    item->setData(Qt::UserRole + 1, d->edge);
+  }
+  regressions_->setUpdatesEnabled(true);
+}
+
+void HppManipulationGraphWidget::regressionActivated(QListWidgetItem* item) {
+  QVariant id = item->data(Qt::UserRole);
+  if (!id.isValid()) return;
+  QGraphicsItem* element = NULL;
+  if (item->data(Qt::UserRole + 1).toBool())
+    element = edges_.value((hpp::ID)id.toLongLong(), NULL);
+  else
+    element = nodes_.value((hpp::ID)id.toLongLong(), NULL);
+  if (element == NULL) return;
+  scene_->clearSelection();
+  element->setSelected(true);
+  view()->centerOn(element);
+  view()->invalidateLod();
+}
+
+void HppManipulationGraphWidget::openSnapshot() {
+  QString filename = QFileDialog::getOpenFileName(
+      this, tr("Open a snapshot"), QString(), SnapshotFilter);
+  if (filename.isEmpty()) return;
+  if (!loadSnapshot(filename))
+    QMessageBox::warning(this, tr("Open a snapshot"),
+                         tr("Could not read %1.").arg(filename));
+}
+
+void HppManipulationGraphWidget::saveSnapshotAs() {
+  QString filename = QFileDialog::getSaveFileName(
+      this, tr("Save a snapshot"), QString(), SnapshotFilter);
+  if (filename.isEmpty()) return;
+  if (!saveSnapshot(filename))
+    QMessageBox::warning(this, tr("Save a snapshot"),
+                         tr("Could not write %1.").arg(filename));
+}
+
+void HppManipulationGraphWidget::compareWithSnapshot() {
+  QString filename = QFileDialog::getOpenFileName(
+      this, tr("Compare with a snapshot"), QString(), SnapshotFilter);
+  if (filename.isEmpty()) return;
+  if (!compareWith(filename))
+    QMessageBox::warning(this, tr("Compare with a snapshot"),
+                         tr("Could not read %1.").arg(filename));
+}
+
+HppManipulationGraphWidget::PolledStats
+HppManipulationGraphWidget::pollStatistics(
+    corbaServer::manipulation::Client* client, bool main,
+    QList<hpp::ID> nodes, QList<hpp::ID> edges, QList<hpp::ID> configOnly) {
+  HPP_PLOT_TRACE("pollStatistics");
+  PolledStats stats;
   try {
-    foreach (QGraphicsItem* elmt, scene_->items()) {
-      QGVNode* node = dynamic_cast<QGVNode*>(elmt);
-      if (node) {
-        NodeInfo& ni = nodeInfos_[node];
-        manip_->graph()->getConfigProjectorStats(ni.id, ni.configStat,
-                                                 ni.pathStat);
-        ni.freq = manip_->graph()->getFrequencyOfNodeInRoadmap(
-            ni.id, ni.freqPerCC.out());
-        float sr = (ni.configStat.nbObs > 0) ? (float)ni.configStat.success /
-                                                   (float)ni.configStat.nbObs
-                                             : 0.f / 0.f;
-        QString colorcode =
-            (ni.configStat.nbObs > 0)
-                ? QColor(255, (int)(sr * 255), (int)(sr * 255)).name()
-                : "white";
-        const QString& fillcolor = node->getAttribute("fillcolor");
-        if (!(fillcolor == colorcode)) {
-          node->setAttribute("fillcolor", colorcode);
-          node->updateLayout();
-        }
+    foreach (hpp::ID id, nodes) {
+      PolledStats::Node& n = stats.nodes[id];
+      ::hpp::intSeq_var freqPerCC;
+      instanceCall(main, HPP_PLOT_METHOD("graph.getConfigProjectorStats"),
+                   [&]() {
+                     client->graph()->getConfigProjectorStats(id, n.configStat,
+                                                              n.pathStat);
+                   });
+      n.freq = instanceCall(
+          main, HPP_PLOT_METHOD("graph.getFrequencyOfNodeInRoadmap"), [&]() {
+            return client->graph()->getFrequencyOfNodeInRoadmap(
+                id, freqPerCC.out());
+          });
+      HPP_PLOT_CALL_BYTES("graph.getFrequencyOfNodeInRoadmap",
+                          seqBytes(freqPerCC.in()));
+      n.freqPerCC.resize((int)freqPerCC->length());
+      for (int k = 0; k < n.freqPerCC.size(); ++k)
+        n.freqPerCC[k] = freqPerCC[(CORBA::ULong)k];
+    }
+    foreach (hpp::ID id, edges) {
+      PolledStats::Edge& e = stats.edges[id];
+      ::hpp::Names_t_var errors;
+      ::hpp::intSeq_var freqs;
+      instanceCall(main, HPP_PLOT_METHOD("graph.getConfigProjectorStats"),
+                   [&]() {
+                     client->graph()->getConfigProjectorStats(id, e.configStat,
+                                                              e.pathStat);
+                   });
+      instanceCall(main, HPP_PLOT_METHOD("graph.getEdgeStat"), [&]() {
+        client->graph()->getEdgeStat(id, errors.out(), freqs.out());
+      });
+      HPP_PLOT_CALL_BYTES("graph.getEdgeStat", seqBytes(freqs.in()));
+      for (CORBA::ULong k = 0; k < errors->length(); ++k)
+        e.errors << QString::fromLocal8Bit(errors[k]);
+      for (CORBA::ULong k = 0; k < freqs->length(); ++k)
+        e.freqs << freqs[k];
+    }
+    foreach (hpp::ID id, configOnly) {
+      PolledStats::Edge& e = stats.edges[id];
+      instanceCall(main, HPP_PLOT_METHOD("graph.getConfigProjectorStats"),
+                   [&]() {
+                     client->graph()->getConfigProjectorStats(id, e.configStat,
+                                                              e.pathStat);
+                   });
+    }
+  } catch (const CORBA::Exception& e) {
+    stats.error = errorMessage(e);
+    stats.unreachable = CircuitBreaker::isUnreachable(e);
+  }
+  return stats;
+}
+
+HppManipulationGraphWidget::PolledStats
+HppManipulationGraphWidget::sumStatistics(const QList<PolledStats>& polled) {
+  PolledStats sum;
+  foreach (const PolledStats& p, polled) {
+    // An unanswered server would count as zero observations.
+    if (!p.error.isEmpty()) continue;
+    for (QMap<hpp::ID, PolledStats::Node>::const_iterator it =
+             p.nodes.constBegin();
+         it != p.nodes.constEnd(); ++it) {
+      bool first = !sum.nodes.contains(it.key());
+      PolledStats::Node& n = sum.nodes[it.key()];
+      if (first) {
+        n = *it;
         continue;
       }
-      QGVEdge* edge = dynamic_cast<QGVEdge*>(elmt);
-      if (edge) {
-        EdgeInfo& ei = edgeInfos_[edge];
-        manip_->graph()->getConfigProjectorStats(ei.id, ei.configStat,
-                                                 ei.pathStat);
-        manip_->graph()->getEdgeStat(ei.id, ei.errors.out(), ei.freqs.out());
-        float sr = (ei.configStat.nbObs > 0) ? (float)ei.configStat.success /
-                                                   (float)ei.configStat.nbObs
-                                             : 0.f / 0.f;
-        QString colorcode = (ei.configStat.nbObs > 0)
-                                ? QColor(255 - (int)(sr * 255), 0, 0).name()
-                                : "";
-        const QString& color = edge->getAttribute("color");
-        if (!(color == colorcode)) {
-          edge->setAttribute("color", colorcode);
-          edge->updateLayout();
-        }
+      addConfigProjStat(n.configStat, it->configStat);
+      addConfigProjStat(n.pathStat, it->pathStat);
+      n.freq += it->freq;
+      n.freqPerCC += it->freqPerCC;
+    }
+    for (QMap<hpp::ID, PolledStats::Edge>::const_iterator it =
+             p.edges.constBegin();
+         it != p.edges.constEnd(); ++it) {
+      bool first = !sum.edges.contains(it.key());
+      PolledStats::Edge& e = sum.edges[it.key()];
+      if (first) {
+        e = *it;
         continue;
       }
+      addConfigProjStat(e.configStat, it->configStat);
+      addConfigProjStat(e.pathStat, it->pathStat);
+      // The errors are matched by name.
+      for (int k = 0; k < it->errors.size() && k < it->freqs.size(); ++k) {
+        int j = e.errors.indexOf(it->errors[k]);
+        if (j < 0 || j >= e.freqs.size()) {
+          e.errors << it->errors[k];
+          e.freqs << it->freqs[k];
+        } else {
+          e.freqs[j] += it->freqs[k];
+        }
+      }
     }
-    scene_->update();
-    selectionChanged();
-  } catch (const CORBA::Exception&) {
-    updateStatsTimer_->stop();
-    statButton_->setChecked(false);
-    throw;
   }
+  return sum;
+}
+
+void HppManipulationGraphWidget::aggregateStatistics(NodeInfo& ni,
+                                                     const PolledStats& stats) {
+  initConfigProjStat(ni.configStat);
+  initConfigProjStat(ni.pathStat);
+  ni.freq = 0;
+  ni.freqPerCC = new ::hpp::intSeq();
+  ni.ccSummary.clear();
+  foreach (hpp::ID id, ni.members) {
+    if (!stats.nodes.contains(id)) continue;
+    const PolledStats::Node& n = stats.nodes[id];
+    addConfigProjStat(ni.configStat, n.configStat);
+    addConfigProjStat(ni.pathStat, n.pathStat);
+    ni.freq += n.freq;
+    CORBA::ULong size = (CORBA::ULong)n.freqPerCC.size();
+    CORBA::ULong length = ni.freqPerCC->length();
+    if (size > length) {
+      ni.freqPerCC->length(size);
+      for (CORBA::ULong k = length; k < size; ++k) ni.freqPerCC[k] = 0;
+    }
+    for (CORBA::ULong k = 0; k < size; ++k)
+      ni.freqPerCC[k] += n.freqPerCC[(int)k];
+  }
+}
+
+void HppManipulationGraphWidget::aggregateStatistics(EdgeInfo& ei,
+                                                     const PolledStats& stats) {
+  initConfigProjStat(ei.configStat);
+  initConfigProjStat(ei.pathStat);
+  foreach (hpp::ID id, ei.members) {
+    if (!stats.edges.contains(id)) continue;
+    addConfigProjStat(ei.configStat, stats.edges[id].configStat);
+    addConfigProjStat(ei.pathStat, stats.edges[id].pathStat);
+  }
+}
+
+void HppManipulationGraphWidget::setInstances(
+    const QList<corbaServer::manipulation::Client*>& others) {
+  foreach (Instance* instance, instances_) retire(instance);
+  instances_.clear();
+  addInstances(others);
+  instanceBox_->setCurrentIndex(0);
+}
+
+void HppManipulationGraphWidget::addInstances(
+    const QList<corbaServer::manipulation::Client*>& others) {
+  foreach (corbaServer::manipulation::Client* client, others) {
+    Instance* instance = new Instance;
+    instance->client = client;
+    instance->poll = new QFutureWatcher<PolledStats>(this);
+    instance->failing = false;
+    instance->retryDelay = 0;
+    connect(instance->poll, SIGNAL(finished()), SLOT(instancePolled()));
+    instances_.append(instance);
+  }
+  int current = instanceBox_->currentIndex();
+  instanceBox_->blockSignals(true);
+  instanceBox_->clear();
+  instanceBox_->addItem(tr("Sum of %1 servers").arg(instances_.size() + 1));
+  instanceBox_->addItem(tr("Main server"));
+  for (int i = 0; i < instances_.size(); ++i)
+    instanceBox_->addItem(tr("Server %1").arg(i + 1));
+  instanceBox_->setCurrentIndex(qMax(0, current));
+  instanceBox_->blockSignals(false);
+  instanceBox_->setVisible(!instances_.isEmpty());
+}
+
+void HppManipulationGraphWidget::retire(Instance* instance) {
+  if (instance->poll->isRunning()) {
+    retired_.append(instance);
+    return;
+  }
+  delete instance->client;
+  delete instance->poll;
+  delete instance;
+}
+
+void HppManipulationGraphWidget::instancePolled() {
+  QFutureWatcher<PolledStats>* poll =
+      static_cast<QFutureWatcher<PolledStats>*>(sender());
+  for (int i = 0; i < retired_.size(); ++i) {
+    if (retired_[i]->poll != poll) continue;
+    Instance* instance = retired_.takeAt(i);
+    delete instance->client;
+    instance->poll->deleteLater();
+    delete instance;
+    return;
+  }
+  for (int i = 0; i < instances_.size(); ++i) {
+    Instance* instance = instances_[i];
+    if (instance->poll != poll) continue;
+    instance->stats = poll->result();
+    // Only the changes of state are logged.
+    if (!instance->stats.error.isEmpty()) {
+      if (!instance->failing)
+        qDebug() << "HppManipulationGraphWidget: server" << i + 1
+                 << "failed:" << instance->stats.error;
+      instance->retryDelay =
+          instance->failing ? qMin<qint64>(2 * instance->retryDelay, 30000)
+                            : 1000;
+      instance->failing = true;
+      instance->failure.start();
+    } else if (instance->failing) {
+      qDebug() << "HppManipulationGraphWidget: server" << i + 1
+               << "answers again";
+      instance->failing = false;
+    }
+    showPolledStatistics();
+    return;
+  }
+}
+
+void HppManipulationGraphWidget::showInstance(int index) {
+  instanceBox_->setCurrentIndex(index + 1);
+}
+
+void HppManipulationGraphWidget::instanceChanged(int) {
+  if (updateStatsTimer_->isActive()) updateStatistics();
 }
 
 void HppManipulationGraphWidget::showNodeOfConfiguration(
     const hpp::floatSeq& cfg) {
   static bool lastlog = false;
   if (manip_ == NULL) return;
-  if (showNodeId_ >= 0) {
+  if (showNodeId_ >= 0 && nodes_.contains(showNodeId_)) {
     // Do unselect
-    nodes_[showNodeId_]->setAttribute("fillcolor", "white");
-    nodes_[showNodeId_]->updateLayout();
+    setColor(nodeInfos_[nodes_[showNodeId_]], DefaultColor);
   }
   try {
-    manip_->graph()->getNode(cfg, showNodeId_);
+    HPP_PLOT_CALL("graph.getNode", manip_->graph()->getNode(cfg, showNodeId_));
+    // Follow the configuration out of the focused neighborhood.
+    if (focused() && !nodes_.contains(showNodeId_) &&
+        cache_.nodeIndex.contains(showNodeId_))
+      focusOn(showNodeId_, focusHops_->value());
     // Do select
     if (nodes_.contains(showNodeId_)) {
-      nodes_[showNodeId_]->setAttribute("fillcolor", "green");
-      nodes_[showNodeId_]->updateLayout();
+      setColor(nodeInfos_[nodes_[showNodeId_]], HighlightColor);
       scene_->update();
     } else {
       qDebug() << "Node" << showNodeId_
@@ -340,54 +1910,113 @@ void HppManipulationGraphWidget::showNodeOfConfiguration(
       showNodeId_ = -1;
     }
     lastlog = false;
-  } catch (const hpp::Error& e) {
+  } catch (const CORBA::Exception& e) {
     if (!lastlog)
       qDebug() << "HppManipulationGraphWidget::showNodeOfConfiguration"
-               << e.msg;
+               << errorMessage(e);
     lastlog = true;
   }
 }
 
 void HppManipulationGraphWidget::showEdge(const hpp::ID& edgeId) {
-  if (showEdgeId_ >= 0) {
+  if (showEdgeId_ >= 0 && edges_.contains(showEdgeId_)) {
     // Do unselect
-    edges_[showEdgeId_]->setAttribute("color", "");
-    edges_[showEdgeId_]->updateLayout();
+    setColor(edgeInfos_[edges_[showEdgeId_]], DefaultColor);
   }
   showEdgeId_ = edgeId;
   // Do select
   if (edges_.contains(showEdgeId_)) {
-    edges_[showEdgeId_]->setAttribute("color", "green");
-    edges_[showEdgeId_]->updateLayout();
+    setColor(edgeInfos_[edges_[showEdgeId_]], HighlightColor);
     scene_->update();
   } else {
     showEdgeId_ = -1;
   }
 }
 
+void HppManipulationGraphWidget::showSuccessRates(
+    const QMap<hpp::ID, double>& rates) {
+  for (QMap<hpp::ID, double>::const_iterator it = rates.constBegin();
+       it != rates.constEnd(); ++it) {
+    // The nodes of a collapsed cluster have no color of their own.
+    if (nodes_.contains(it.key())) {
+      NodeInfo& ni = nodeInfos_[nodes_[it.key()]];
+      if (ni.members.isEmpty()) setColor(ni, rateColor((float)*it));
+    } else if (edges_.contains(it.key()))
+      setColor(edgeInfos_[edges_[it.key()]], rateColor((float)*it));
+  }
+  ratesShown_ = true;
+  scene_->update();
+}
+
+void HppManipulationGraphWidget::hideSuccessRates() {
+  if (!ratesShown_) return;
+  ratesShown_ = false;
+  if (comparing()) {
+    updateComparison();
+  } else {
+    for (QMap<QGVNode*, NodeInfo>::iterator it = nodeInfos_.begin();
+         it != nodeInfos_.end(); ++it)
+      setColor(*it, statColor(it->configStat));
+    for (QMap<QGVEdge*, EdgeInfo>::iterator it = edgeInfos_.begin();
+         it != edgeInfos_.end(); ++it)
+      setColor(*it, statColor(it->configStat));
+  }
+  view()->invalidateLod();
+  scene_->update();
+}
+
 void HppManipulationGraphWidget::nodeContextMenu(QGVNode* node) {
   const NodeInfo& ni = nodeInfos_[node];
   hpp::ID id = currentId_;
   currentId_ = ni.id;
+  hpp::ID nodeId = ni.id;
+  QString cluster = ni.cluster;
 
   QMenu cm("Node context menu", this);
-  foreach (GraphAction* action, nodeContextMenuActions_) {
-    cm.addAction(action);
-  }
-  cm.exec(QCursor::pos());
+  QAction *focus = NULL, *expand = NULL, *collapse = NULL;
+  if (ni.members.isEmpty()) {
+    foreach (GraphAction* action, nodeContextMenuActions_) {
+      cm.addAction(action);
+    }
+    cm.addSeparator();
+    focus = cm.addAction("&Focus here");
+    if (!cluster.isNull()) collapse = cm.addAction("&Collapse cluster");
+  } else
+    expand = cm.addAction("&Expand cluster");
+  QAction* chosen = cm.exec(QCursor::pos());
 
   currentId_ = id;
+  // This clears the scene, so node must not be used afterwards.
+  if (chosen == NULL) return;
+  if (chosen == focus)
+    focusOn(nodeId, focusHops_->value());
+  else if (chosen == expand)
+    expandCluster(cluster);
+  else if (chosen == collapse)
+    collapseCluster(cluster);
 }
 
 void HppManipulationGraphWidget::nodeDoubleClick(QGVNode* node) {
   const NodeInfo& ni = nodeInfos_[node];
+  if (!ni.members.isEmpty()) {
+    // Copied, as the scene is cleared.
+    QString cluster = ni.cluster;
+    expandCluster(cluster);
+    return;
+  }
   displayNodeConstraint(ni.id);
 }
 
 void HppManipulationGraphWidget::displayNodeConstraint(hpp::ID id) {
   if (manip_ == NULL) return;
   CORBA::String_var str;
-  manip_->graph()->displayNodeConstraints(id, str.out());
+  try {
+    HPP_PLOT_CALL("graph.displayNodeConstraints",
+                  manip_->graph()->displayNodeConstraints(id, str.out()));
+  } catch (const CORBA::Exception& e) {
+    constraintInfo_->setText(errorMessage(e));
+    return;
+  }
   QString nodeStr(str);
   constraintInfo_->setText(nodeStr);
 }
@@ -395,7 +2024,13 @@ void HppManipulationGraphWidget::displayNodeConstraint(hpp::ID id) {
 void HppManipulationGraphWidget::displayEdgeConstraint(hpp::ID id) {
   if (manip_ == NULL) return;
   CORBA::String_var str;
-  manip_->graph()->displayEdgeConstraints(id, str.out());
+  try {
+    HPP_PLOT_CALL("graph.displayEdgeConstraints",
+                  manip_->graph()->displayEdgeConstraints(id, str.out()));
+  } catch (const CORBA::Exception& e) {
+    constraintInfo_->setText(errorMessage(e));
+    return;
+  }
   QString nodeStr(str);
   constraintInfo_->setText(nodeStr);
 }
@@ -403,13 +2038,21 @@ void HppManipulationGraphWidget::displayEdgeConstraint(hpp::ID id) {
 void HppManipulationGraphWidget::displayEdgeTargetConstraint(hpp::ID id) {
   if (manip_ == NULL) return;
   CORBA::String_var str;
-  manip_->graph()->displayEdgeTargetConstraints(id, str.out());
+  try {
+    HPP_PLOT_CALL("graph.displayEdgeTargetConstraints",
+                  manip_->graph()->displayEdgeTargetConstraints(id, str.out()));
+  } catch (const CORBA::Exception& e) {
+    constraintInfo_->setText(errorMessage(e));
+    return;
+  }
   QString nodeStr(str);
   constraintInfo_->setText(nodeStr);
 }
 
 void HppManipulationGraphWidget::edgeContextMenu(QGVEdge* edge) {
   const EdgeInfo& ei = edgeInfos_[edge];
+  // Merged edges have no ID to act on.
+  if (!ei.members.isEmpty()) return;
   hpp::ID id = currentId_;
   currentId_ = ei.id;
 
@@ -417,24 +2060,155 @@ void HppManipulationGraphWidget::edgeContextMenu(QGVEdge* edge) {
   foreach (GraphAction* action, edgeContextMenuActions_) {
     cm.addAction(action);
   }
-  cm.exec(QCursor::pos());
+  cm.addSeparator();
+  QAction* focus = cm.addAction("&Focus here");
+  bool doFocus = (cm.exec(QCursor::pos()) == focus);
 
   currentId_ = id;
+  // This clears the scene, so edge must not be used afterwards.
+  if (doFocus) focusOn(ei.id, focusHops_->value());
 }
 
 void HppManipulationGraphWidget::edgeDoubleClick(QGVEdge* edge) {
   EdgeInfo& ei = edgeInfos_[edge];
+  if (!ei.members.isEmpty()) return;
   bool ok;
   ::CORBA::Long w = QInputDialog::getInt(
       this, "Update edge weight", tr("Edge %1 weight").arg(ei.name), ei.weight,
       0, std::numeric_limits<int>::max(), 1, &ok);
-  if (ok) {
-    updateWeight(ei, w);
-    edge->updateLayout();
+  if (ok && w != ei.weight) {
+    QMap<hpp::ID, ::CORBA::Long> weight;
+    weight[ei.id] = w;
+    pushWeights(weight, tr("Set weight of %1").arg(ei.name));
+  }
+}
+
+void HppManipulationGraphWidget::editSelectedWeights() {
+  QList<const EdgeInfo*> selected;
+  foreach (QGraphicsItem* item, scene_->selectedItems()) {
+    QGVEdge* edge = dynamic_cast<QGVEdge*>(item);
+    // Transitions inside waypoint edges have a negative weight which must
+    // be kept. Merged edges have no weight of their own.
+    if (edge && edgeInfos_.contains(edge) && edgeInfos_[edge].weight >= 0 &&
+        edgeInfos_[edge].members.isEmpty())
+      selected.append(&edgeInfos_[edge]);
+  }
+  if (selected.isEmpty()) {
+    QMessageBox::information(this, "Edit weights",
+                             "Select edges first. Hold Shift to select them "
+                             "with a rubber band.");
+    return;
+  }
+
+  QDialog dialog(this);
+  dialog.setWindowTitle(tr("Edit weights of %1 edges").arg(selected.size()));
+  QComboBox* mode = new QComboBox(&dialog);
+  mode->addItems(QStringList() << "Set to"
+                               << "Multiply by"
+                               << "Formula of w");
+  QDoubleSpinBox* value = new QDoubleSpinBox(&dialog);
+  value->setRange(0, std::numeric_limits<int>::max());
+  value->setValue(1);
+  QLineEdit* formula = new QLineEdit("2*w+1", &dialog);
+  QDialogButtonBox* buttons = new QDialogButtonBox(
+      QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  QFormLayout* layout = new QFormLayout(&dialog);
+  layout->addRow("Operation", mode);
+  layout->addRow("Value", value);
+  layout->addRow("Formula", formula);
+  layout->addRow(buttons);
+  if (dialog.exec() != QDialog::Accepted) return;
+
+  QMap<hpp::ID, ::CORBA::Long> weights;
+  foreach (const EdgeInfo* ei, selected) {
+    double w;
+    switch (mode->currentIndex()) {
+      case 0:
+        w = value->value();
+        break;
+      case 1:
+        w = value->value() * ei->weight;
+        break;
+      default:
+        if (!WeightFormula(formula->text(), ei->weight).eval(w)) {
+          QMessageBox::warning(this, "Edit weights",
+                               tr("Invalid formula %1").arg(formula->text()));
+          return;
+        }
+    }
+    ::CORBA::Long nw = (::CORBA::Long)qBound(
+        0., w + .5, (double)std::numeric_limits< ::CORBA::Long>::max());
+    if (nw != ei->weight) weights[ei->id] = nw;
+  }
+  if (weights.isEmpty()) return;
+  weights =
+      pushWeights(weights, tr("Set weights of %1 edges").arg(weights.size()));
+  // The tuning starts again from the weights set by hand.
+  for (QMap<hpp::ID, ::CORBA::Long>::const_iterator it = weights.constBegin();
+       it != weights.constEnd(); ++it)
+    if (tuneBase_.contains(it.key())) tuneBase_[it.key()] = it.value();
+}
+
+QMap<hpp::ID, ::CORBA::Long> HppManipulationGraphWidget::pushWeights(
+    const QMap<hpp::ID, ::CORBA::Long>& weights, const QString& text) {
+  QMap<hpp::ID, ::CORBA::Long> before;
+  for (QMap<hpp::ID, ::CORBA::Long>::const_iterator it = weights.constBegin();
+       it != weights.constEnd(); ++it) {
+    if (cache_.edgeIndex.contains(it.key()))
+      before[it.key()] = cache_.edges[cache_.edgeIndex[it.key()]].weight;
+    else if (edges_.contains(it.key()))
+      before[it.key()] = edgeInfos_[edges_[it.key()]].weight;
   }
+  // Only the weights accepted by the server can be undone.
+  QMap<hpp::ID, ::CORBA::Long> applied = setWeights(weights);
+  if (applied.isEmpty()) return applied;
+  for (QMap<hpp::ID, ::CORBA::Long>::iterator it = before.begin();
+       it != before.end();)
+    if (applied.contains(it.key()))
+      ++it;
+    else
+      it = before.erase(it);
+  undoStack_->push(new SetWeightsCommand(this, before, applied, text));
+  return applied;
+}
+
+QMap<hpp::ID, ::CORBA::Long> HppManipulationGraphWidget::setWeights(
+    const QMap<hpp::ID, ::CORBA::Long>& weights) {
+  QMap<hpp::ID, ::CORBA::Long> applied;
+  if (manip_ == NULL) return applied;
+  for (QMap<hpp::ID, ::CORBA::Long>::const_iterator it = weights.constBegin();
+       it != weights.constEnd(); ++it) {
+    try {
+      HPP_PLOT_CALL("graph.setWeight",
+                    manip_->graph()->setWeight(it.key(), it.value()));
+    } catch (const CORBA::Exception& e) {
+      qDebug() << "HppManipulationGraphWidget::setWeights" << it.key()
+               << errorMessage(e);
+      continue;
+    }
+    applied[it.key()] = it.value();
+    if (cache_.edgeIndex.contains(it.key()))
+      cache_.edges[cache_.edgeIndex[it.key()]].weight = it.value();
+    if (!edges_.contains(it.key())) continue;
+    QGVEdge* edge = edges_[it.key()];
+    EdgeInfo& ei = edgeInfos_[edge];
+    ei.weight = it.value();
+    updateWeight(ei, false);
+    updateStyle(edge);
+  }
+  if (applied.size() < weights.size())
+    qDebug() << "HppManipulationGraphWidget::setWeights: the server accepted"
+             << applied.size() << "of" << weights.size() << "weights";
+  view()->invalidateLod();
+  scene_->update();
+  selectionChanged();
+  return applied;
 }
 
 void HppManipulationGraphWidget::selectionChanged() {
+  HPP_PLOT_TRACE("selectionChanged");
   QList<QGraphicsItem*> items = scene_->selectedItems();
   currentId_ = -1;
 
@@ -458,16 +2232,19 @@ void HppManipulationGraphWidget::selectionChanged() {
     if (node) {
       type = "Node";
       name = node->label();
-      const NodeInfo& ni = nodeInfos_[node];
+      NodeInfo& ni = nodeInfos_[node];
       id = ni.id;
       currentId_ = id;
       constraints = ni.constraintStr;
-      end = QString("<p><h4>Nb node in roadmap:</h4> %1</p>").arg(ni.freq);
-      end.append("<p><h4>Nb node in roadmap per connected component</h4>\n");
-      for (std::size_t i = 0; i < ni.freqPerCC->length(); ++i) {
-        end.append(QString(" %1,").arg(ni.freqPerCC.in()[(CORBA::ULong)i]));
+      if (!ni.members.isEmpty()) {
+        type = "Cluster";
+        name = ni.cluster;
+        weight = QString("<li>States: %1</li>").arg(ni.members.size());
       }
-      end.append("</p>");
+      end = QString("<p><h4>Nb node in roadmap:</h4> %1</p>").arg(ni.freq);
+      if (ni.ccSummary.isEmpty())
+        ni.ccSummary = summarizeComponents(ni.freqPerCC.in());
+      end.append(ni.ccSummary);
     } else if (edge) {
       type = "Edge";
       const EdgeInfo& ei = edgeInfos_[edge];
@@ -475,6 +2252,22 @@ void HppManipulationGraphWidget::selectionChanged() {
       id = ei.id;
       currentId_ = id;
       weight = QString("<li>Weight: %1</li>").arg(ei.weight);
+      if (!ei.members.isEmpty()) {
+        type = "Edges";
+        weight.clear();
+        end = "<p><h4>Merged transitions</h4><ul>";
+        foreach (hpp::ID m, ei.members) {
+          end.append(
+              QString("<li>%1</li>")
+                  .arg(ESCAPE(cache_.edges[cache_.edgeIndex[m]].name)));
+        }
+        end.append("</ul></p>");
+        elmtInfo_->setText(QString("<h4>%1 %2</h4>%3")
+                               .arg(type)
+                               .arg(ESCAPE(name))
+                               .arg(end));
+        return;
+      }
       end = "<p>Extension results<ul>";
       for (std::size_t i = 0;
            i < std::min(ei.errors->length(), ei.freqs->length()); ++i) {
@@ -489,14 +2282,27 @@ void HppManipulationGraphWidget::selectionChanged() {
     } else {
       return;
     }
+  } else {
+    int nbNodes = 0, nbEdges = 0;
+    foreach (QGraphicsItem* item, items) {
+      if (dynamic_cast<QGVNode*>(item)) ++nbNodes;
+      if (dynamic_cast<QGVEdge*>(item)) ++nbEdges;
+    }
+    elmtInfo_->setText(QString("<h4>Selection</h4><ul>"
+                               "<li>%1 nodes</li>"
+                               "<li>%2 edges</li></ul>")
+                           .arg(nbNodes)
+                           .arg(nbEdges));
+    return;
   }
   elmtInfo_->setText(QString("<h4>%1 %2</h4><ul>"
-                             "<li>Id: %3</li>"
+                             "%3"
                              "%4"
                              "</ul>%5%6")
                          .arg(type)
                          .arg(ESCAPE(name))
-                         .arg(id)
+                         .arg((id >= 0) ? QString("<li>Id: %1</li>").arg(id)
+                                        : QString())
                          .arg(weight)
                          .arg(end)
                          .arg(constraints));
@@ -509,13 +2315,125 @@ void HppManipulationGraphWidget::startStopUpdateStats(bool start) {
     updateStatsTimer_->stop();
 }
 
+void HppManipulationGraphWidget::startStopTuning(bool start) {
+  if (start) {
+    if (!statButton_->isChecked()) {
+      statButton_->setChecked(true);
+      startStopUpdateStats(true);
+    }
+    // The tuning scales the weights set before it starts.
+    tuneBase_.clear();
+    foreach (const EdgeInfo& ei, edgeInfos_)
+      if (ei.id >= 0 && ei.members.isEmpty()) tuneBase_[ei.id] = ei.weight;
+    tuneTimer_->start();
+  } else
+    tuneTimer_->stop();
+}
+
+void HppManipulationGraphWidget::setTuningBounds(::CORBA::Long minWeight,
+                                                 ::CORBA::Long maxWeight) {
+  tuneMinWeight_ = std::max(1, (int)minWeight);
+  tuneMaxWeight_ = std::max(tuneMinWeight_, maxWeight);
+}
+
+void HppManipulationGraphWidget::setTuningInterval(int msec) {
+  tuneTimer_->setInterval(msec);
+}
+
+QMap<hpp::ID, ::CORBA::Long> HppManipulationGraphWidget::suggestWeights()
+    const {
+  QMap<hpp::ID, ::CORBA::Long> weights;
+
+  // Mean number of roadmap nodes in the states that have some.
+  double meanFreq = 0;
+  int nbNodes = 0;
+  foreach (const NodeInfo& ni, nodeInfos_) {
+    if (ni.freq <= 0 || !ni.members.isEmpty()) continue;
+    meanFreq += ni.freq;
+    ++nbNodes;
+  }
+  if (nbNodes > 0) meanFreq /= nbNodes;
+
+  foreach (const EdgeInfo& ei, edgeInfos_) {
+    if (ei.edge == NULL || ei.weight <= 0 || !ei.members.isEmpty()) continue;
+    if (ei.configStat.nbObs < tuneMinObs_) continue;
+    double sr = (double)ei.configStat.success / (double)ei.configStat.nbObs;
+    double factor = .5 + sr;
+
+    QGVNode* target = nodes_.value(ei.end, NULL);
+    if (target != NULL && nodeInfos_[target].members.isEmpty() &&
+        meanFreq > 0) {
+      double coverage = nodeInfos_[target].freq / meanFreq;
+      factor *= qBound(.5, 1. / std::sqrt(std::max(coverage, .1)), 2.);
+    }
+    factor = qBound(.5, factor, 2.);
+
+    ::CORBA::Long base = tuneBase_.value(ei.id, ei.weight);
+    if (base <= 0) continue;
+    ::CORBA::Long w = (::CORBA::Long)(base * factor + .5);
+    w = qBound(tuneMinWeight_, w, tuneMaxWeight_);
+    if (w != ei.weight) weights[ei.id] = w;
+  }
+  return weights;
+}
+
+void HppManipulationGraphWidget::tuneWeights() {
+  if (manip_ == NULL) return;
+  // Edges drawn since the tuning started.
+  foreach (const EdgeInfo& ei, edgeInfos_)
+    if (ei.id >= 0 && ei.members.isEmpty() && !tuneBase_.contains(ei.id))
+      tuneBase_[ei.id] = ei.weight;
+  QMap<hpp::ID, ::CORBA::Long> weights = suggestWeights();
+  if (weights.isEmpty()) return;
+  QString text = tr("Tune weights of %1 edges").arg(weights.size());
+  if (tuneAutoApply_->isChecked()) {
+    pushWeights(weights, text);
+    return;
+  }
+
+  // Preview the changes: green edges get a higher weight, blue ones a lower
+  // weight. The statistics would color the edges again.
+  tuneTimer_->stop();
+  bool polling = updateStatsTimer_->isActive();
+  updateStatsTimer_->stop();
+  QString diff("<h4>Suggested weights</h4><table>"
+               "<tr><th>Edge</th><th>Current</th><th>Suggested</th></tr>");
+  for (QMap<hpp::ID, ::CORBA::Long>::const_iterator it = weights.constBegin();
+       it != weights.constEnd(); ++it) {
+    EdgeInfo& ei = edgeInfos_[edges_[it.key()]];
+    setColor(ei, (*it > ei.weight) ? IncreaseColor : DecreaseColor);
+    diff.append(QString("<tr><td>%1</td><td>%2</td><td>%3</td></tr>")
+                    .arg(ESCAPE(ei.name))
+                    .arg(ei.weight)
+                    .arg(*it));
+  }
+  diff.append("</table>");
+  scene_->update();
+  elmtInfo_->setText(diff);
+
+  if (QMessageBox::question(
+          this, "Tune weights",
+          tr("Apply the suggested weights of %1 edges ?").arg(weights.size()),
+          QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+    pushWeights(weights, text);
+  // Restore the colors of the statistics.
+  updateStatistics();
+  if (polling) updateStatsTimer_->start();
+  if (tuneButton_->isChecked()) tuneTimer_->start();
+}
+
 HppManipulationGraphWidget::NodeInfo::NodeInfo()
-    : id(-1), freq(0), freqPerCC(new ::hpp::intSeq()) {
+    : id(-1),
+      node(NULL),
+      color(DefaultColor),
+      freq(0),
+      freqPerCC(new ::hpp::intSeq()) {
   initConfigProjStat(configStat);
   initConfigProjStat(pathStat);
 }
 
-HppManipulationGraphWidget::EdgeInfo::EdgeInfo() : id(-1), edge(NULL) {
+HppManipulationGraphWidget::EdgeInfo::EdgeInfo()
+    : id(-1), start(-1), end(-1), weight(0), edge(NULL), color(DefaultColor) {
   initConfigProjStat(configStat);
   initConfigProjStat(pathStat);
   errors = new Names_t();
@@ -523,8 +2441,11 @@ HppManipulationGraphWidget::EdgeInfo::EdgeInfo() : id(-1), edge(NULL) {
 }
 
 void HppManipulationGraphWidget::updateWeight(EdgeInfo& ei, bool get) {
-  if (manip_ == NULL) return;
-  if (get) ei.weight = manip_->graph()->getWeight(ei.id);
+  if (get) {
+    if (manip_ == NULL) return;
+    ei.weight =
+        HPP_PLOT_CALL("graph.getWeight", manip_->graph()->getWeight(ei.id));
+  }
   if (ei.edge == NULL) return;
   if (ei.weight <= 0) {
     ei.edge->setAttribute("style", "dashed");
@@ -535,24 +2456,38 @@ void HppManipulationGraphWidget::updateWeight(EdgeInfo& ei, bool get) {
   }
 }
 
-void HppManipulationGraphWidget::updateWeight(EdgeInfo& ei,
-                                              const ::CORBA::Long w) {
-  if (manip_ == NULL) return;
-  manip_->graph()->setWeight(ei.id, w);
-  ei.weight = w;
-  updateWeight(ei, false);
+void HppManipulationGraphWidget::setColor(NodeInfo& ni, int key) {
+  if (ni.color == key || ni.node == NULL) return;
+  ni.color = key;
+  ni.node->setAttribute("fillcolor", nodeColor(key));
+  updateStyle(ni.node);
 }
 
-QString HppManipulationGraphWidget::getConstraints(hpp::ID id) {
+void HppManipulationGraphWidget::setColor(EdgeInfo& ei, int key) {
+  if (ei.color == key || ei.edge == NULL) return;
+  ei.color = key;
+  ei.edge->setAttribute("color", edgeColor(key));
+  updateStyle(ei.edge);
+}
+
+QStringList HppManipulationGraphWidget::getConstraintNames(hpp::ID id) {
   assert(manip_ != NULL);
-  QString ret;
+  QStringList names;
   hpp::Names_t_var c = new hpp::Names_t;
-  manip_->graph()->getNumericalConstraints(id, c);
+  HPP_PLOT_CALL("graph.getNumericalConstraints",
+                manip_->graph()->getNumericalConstraints(id, c));
+  for (unsigned i = 0; i < c->length(); i++) names << QString(c[i].in());
+  return names;
+}
+
+QString HppManipulationGraphWidget::formatConstraints(
+    const QStringList& names) {
+  QString ret;
   ret.append("<p><h4>Applied constraints</h4>");
-  if (c->length() > 0) {
+  if (!names.isEmpty()) {
     ret.append("<ul>");
-    for (unsigned i = 0; i < c->length(); i++) {
-      ret.append(QString("<li>%1</li>").arg(c[i].in()));
+    foreach (const QString& name, names) {
+      ret.append(QString("<li>%1</li>").arg(name));
     }
     ret.append("</ul></p>");
   } else
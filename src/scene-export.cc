@@ -0,0 +1,248 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "hpp/plot/scene-export.hh"
+
+#include <zlib.h>
+
+#include <QFile>
+#include <QFuture>
+#include <QGraphicsItem>
+#include <QGraphicsScene>
+#include <QImage>
+#include <QPainter>
+#include <QPicture>
+#include <QPrinter>
+#include <QQueue>
+#include <QThread>
+#include <QVector>
+#include <cmath>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QtConcurrent>
+#else
+#include <QtCore>
+#endif
+
+#include "hpp/plot/tracer.hh"
+
+namespace hpp {
+namespace plot {
+namespace {
+/// Upper bound of the size of a band, in bytes.
+const int MaxBandBytes = 8 << 20;
+
+/// Write an RGB PNG image row by row.
+class PngWriter {
+ public:
+  PngWriter(QIODevice* device, int width, int height)
+      : device_(device), width_(width), ok_(true) {
+    stream_.zalloc = Z_NULL;
+    stream_.zfree = Z_NULL;
+    stream_.opaque = Z_NULL;
+    ok_ = deflateInit(&stream_, Z_DEFAULT_COMPRESSION) == Z_OK;
+    static const char signature[] = "\x89PNG\r\n\x1a\n";
+    ok_ = ok_ && device_->write(signature, 8) == 8;
+    QByteArray header;
+    appendUInt(header, (quint32)width);
+    appendUInt(header, (quint32)height);
+    // Bit depth 8, truecolor, deflate, adaptive filtering, no interlace.
+    header.append("\x08\x02\x00\x00\x00", 5);
+    writeChunk("IHDR", header);
+  }
+
+  ~PngWriter() { deflateEnd(&stream_); }
+
+  /// Append the rows of an image of format RGB32 and of the same width.
+  void writeRows(const QImage& image) {
+    QByteArray row(1 + 3 * width_, '\0');
+    for (int y = 0; y < image.height() && ok_; ++y) {
+      const QRgb* pixels = (const QRgb*)image.constScanLine(y);
+      // Filter type 0: the row as is.
+      char* out = row.data() + 1;
+      for (int x = 0; x < width_; ++x) {
+        *out++ = (char)qRed(pixels[x]);
+        *out++ = (char)qGreen(pixels[x]);
+        *out++ = (char)qBlue(pixels[x]);
+      }
+      encode(row, Z_NO_FLUSH);
+    }
+  }
+
+  bool finish() {
+    encode(QByteArray(), Z_FINISH);
+    if (!idat_.isEmpty()) writeChunk("IDAT", idat_);
+    writeChunk("IEND", QByteArray());
+    return ok_;
+  }
+
+ private:
+  static void appendUInt(QByteArray& bytes, quint32 v) {
+    bytes.append((char)(v >> 24));
+    bytes.append((char)(v >> 16));
+    bytes.append((char)(v >> 8));
+    bytes.append((char)v);
+  }
+
+  void encode(const QByteArray& in, int flush) {
+    char buffer[1 << 16];
+    stream_.next_in = (Bytef*)in.constData();
+    stream_.avail_in = (uInt)in.size();
+    int ret;
+    do {
+      stream_.next_out = (Bytef*)buffer;
+      stream_.avail_out = sizeof(buffer);
+      ret = deflate(&stream_, flush);
+      if (ret == Z_STREAM_ERROR) {
+        ok_ = false;
+        return;
+      }
+      idat_.append(buffer, (int)(sizeof(buffer) - stream_.avail_out));
+      if (idat_.size() >= (1 << 18)) {
+        writeChunk("IDAT", idat_);
+        idat_.clear();
+      }
+    } while (stream_.avail_out == 0 ||
+             (flush == Z_FINISH && ret != Z_STREAM_END));
+  }
+
+  void writeChunk(const char* type, const QByteArray& data) {
+    QByteArray chunk;
+    appendUInt(chunk, (quint32)data.size());
+    chunk.append(type, 4);
+    chunk.append(data);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)chunk.constData() + 4,
+                (uInt)(chunk.size() - 4));
+    appendUInt(chunk, (quint32)crc);
+    ok_ = ok_ && device_->write(chunk) == chunk.size();
+  }
+
+  QIODevice* device_;
+  int width_;
+  bool ok_;
+  z_stream stream_;
+  /// Compressed data not written yet.
+  QByteArray idat_;
+};
+
+/// Rasterize the rows band of the image of the recorded scene.
+/// \param recording the data of a QPicture. Copies of a QPicture share
+///        the buffer that play() reads, so each band gets its own.
+QImage renderBand(QByteArray recording, QRectF source, qreal scale,
+                  QRect band) {
+  QPicture picture;
+  picture.setData(recording.constData(), (uint)recording.size());
+  QImage image(band.size(), QImage::Format_RGB32);
+  image.fill(0xffffffff);
+  QPainter painter(&image);
+  painter.setRenderHints(QPainter::Antialiasing |
+                         QPainter::TextAntialiasing |
+                         QPainter::SmoothPixmapTransform);
+  painter.translate(-band.topLeft());
+  painter.scale(scale, scale);
+  painter.translate(-source.topLeft());
+  painter.drawPicture(0, 0, picture);
+  painter.end();
+  return image;
+}
+
+/// Record the drawing of the items, in scene coordinates.
+QPicture record(QGraphicsScene* scene, const QRectF& rect) {
+  // Cached items would be recorded as pixmaps, at the resolution of the
+  // screen.
+  QList<QGraphicsItem*> items = scene->items();
+  QVector<QGraphicsItem::CacheMode> modes(items.size());
+  for (int i = 0; i < items.size(); ++i) {
+    modes[i] = items[i]->cacheMode();
+    items[i]->setCacheMode(QGraphicsItem::NoCache);
+  }
+  QPicture picture;
+  QPainter painter(&picture);
+  scene->render(&painter, rect, rect);
+  painter.end();
+  for (int i = 0; i < items.size(); ++i) items[i]->setCacheMode(modes[i]);
+  return picture;
+}
+
+bool exportPdf(QGraphicsScene* scene, const QString& filename,
+               const QRectF& rect) {
+  QPrinter printer(QPrinter::HighResolution);
+  printer.setOutputFormat(QPrinter::PdfFormat);
+  printer.setOutputFileName(filename);
+  printer.setFullPage(true);
+  printer.setPaperSize(rect.size(), QPrinter::Point);
+  printer.setPageMargins(0, 0, 0, 0, QPrinter::Point);
+  QPainter painter;
+  if (!painter.begin(&printer)) return false;
+  scene->render(&painter, QRectF(), rect);
+  return painter.end();
+}
+
+bool exportPng(QGraphicsScene* scene, const QString& filename,
+               const QRectF& rect, qreal scale) {
+  int width = qMax(1, (int)std::ceil(rect.width() * scale)),
+      height = qMax(1, (int)std::ceil(rect.height() * scale));
+  int bandHeight = qBound(1, MaxBandBytes / (4 * width), height);
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) return false;
+  PngWriter png(&file, width, height);
+
+  QPicture picture = record(scene, rect);
+  // Keep a band ahead per thread.
+  int ahead = qMax(1, QThread::idealThreadCount());
+  QQueue<QFuture<QImage> > bands;
+  int next = 0;
+  while (next < height || !bands.isEmpty()) {
+    while (next < height && bands.size() < ahead) {
+      QRect band(0, next, width, qMin(bandHeight, height - next));
+      bands.enqueue(QtConcurrent::run(
+          renderBand, QByteArray(picture.data(), (int)picture.size()), rect,
+          scale, band));
+      next += band.height();
+    }
+    png.writeRows(bands.dequeue().result());
+  }
+  return png.finish() && file.flush();
+}
+}  // namespace
+
+bool exportScene(QGraphicsScene* scene, const QString& filename,
+                 qreal scale) {
+  HPP_PLOT_TRACE("exportScene");
+  QRectF rect = scene->itemsBoundingRect();
+  if (rect.isEmpty() || scale <= 0) return false;
+  if (filename.endsWith(".pdf", Qt::CaseInsensitive))
+    return exportPdf(scene, filename, rect);
+  return exportPng(scene, filename, rect, scale);
+}
+}  // namespace plot
+}  // namespace hpp
@@ -0,0 +1,149 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "hpp/plot/search-index.hh"
+
+#include <QRegExp>
+#include <QSet>
+
+namespace hpp {
+namespace plot {
+void SearchIndex::clear() {
+  docs_.clear();
+  trigrams_.clear();
+}
+
+int SearchIndex::add(const QStringList& fields) {
+  int doc = docs_.size();
+  QString text = fields.join("\n").toLower();
+  docs_.append(text);
+  QSet<quint64> seen;
+  for (int i = 0; i + 2 < text.size(); ++i) {
+    quint64 t = trigram(text, i);
+    if (seen.contains(t)) continue;
+    seen.insert(t);
+    trigrams_[t].append(doc);
+  }
+  return doc;
+}
+
+QVector<int> SearchIndex::find(const QString& text) const {
+  QStringList words =
+      text.toLower().split(QRegExp("\\s+"), QString::SkipEmptyParts);
+  QVector<int> result;
+
+  // The smallest posting list of the trigrams of the words.
+  const QVector<int>* candidates = NULL;
+  foreach (const QString& word, words) {
+    for (int i = 0; i + 2 < word.size(); ++i) {
+      QHash<quint64, QVector<int> >::const_iterator it =
+          trigrams_.constFind(trigram(word, i));
+      if (it == trigrams_.constEnd()) return result;
+      if (candidates == NULL || it->size() < candidates->size())
+        candidates = &*it;
+    }
+  }
+
+  int n = (candidates != NULL) ? candidates->size() : docs_.size();
+  for (int k = 0; k < n; ++k) {
+    int doc = (candidates != NULL) ? (*candidates)[k] : k;
+    bool match = true;
+    foreach (const QString& word, words) {
+      if (!docs_[doc].contains(word)) {
+        match = false;
+        break;
+      }
+    }
+    if (match) result.append(doc);
+  }
+  return result;
+}
+
+bool SearchFilter::accepts(double v) const {
+  switch (op) {
+    case Less:
+      return v < value;
+    case LessEqual:
+      return v <= value;
+    case Greater:
+      return v > value;
+    case GreaterEqual:
+      return v >= value;
+    case Equal:
+      return v == value;
+    case NotEqual:
+      return v != value;
+  }
+  return false;
+}
+
+QList<SearchFilter> SearchFilter::extract(QString& query,
+                                          const QStringList& fields) {
+  // Longest first, so that "success rate" is preferred over "rate".
+  QStringList names;
+  foreach (const QString& f, fields) {
+    int i = 0;
+    while (i < names.size() && names[i].size() >= f.size()) ++i;
+    names.insert(i, QRegExp::escape(f));
+  }
+  QRegExp re(QString("\\b(%1)\\s*(<=|>=|==|!=|<|>|=)\\s*(-?[0-9]*\\.?[0-9]+)"
+                     "\\s*(%?)")
+                 .arg(names.join("|")),
+             Qt::CaseInsensitive);
+
+  QList<SearchFilter> filters;
+  int pos = 0;
+  while ((pos = re.indexIn(query, pos)) != -1) {
+    SearchFilter f;
+    f.field = re.cap(1).toLower();
+    const QString op = re.cap(2);
+    if (op == "<")
+      f.op = Less;
+    else if (op == "<=")
+      f.op = LessEqual;
+    else if (op == ">")
+      f.op = Greater;
+    else if (op == ">=")
+      f.op = GreaterEqual;
+    else if (op == "!=")
+      f.op = NotEqual;
+    else
+      f.op = Equal;
+    f.value = re.cap(3).toDouble();
+    if (!re.cap(4).isEmpty()) f.value /= 100;
+    filters.append(f);
+    query.remove(pos, re.matchedLength());
+  }
+  return filters;
+}
+}  // namespace plot
+}  // namespace hpp
@@ -0,0 +1,202 @@
+// BSD 2-Clause License
+
+// Copyright (c) 2015 - 2018, hpp-plot
+// Authors: Heidy Dallard, Joseph Mirabel
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in
+//   the documentation and/or other materials provided with the
+//   distribution.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+// HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+// OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "hpp/plot/tracer.hh"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+namespace hpp {
+namespace plot {
+/// Single producer, single consumer ring buffer.
+///
+/// The owning thread is the only one to write head_, the flushing thread,
+/// holding Tracer::mutex_, is the only one to write tail_.
+class Tracer::Buffer {
+ public:
+  enum { Capacity = 1 << 15 };
+
+  Buffer(int tid, const QString& threadName)
+      : tid(tid),
+        threadName(threadName),
+        orphan(false),
+        events_(Capacity),
+        head_(0),
+        tail_(0) {}
+
+  bool push(const Event& e) {
+    quint64 h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) >= (quint64)Capacity)
+      return false;
+    events_[(int)(h % Capacity)] = e;
+    head_.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename F>
+  int drain(F f) {
+    quint64 t = tail_.load(std::memory_order_relaxed);
+    quint64 h = head_.load(std::memory_order_acquire);
+    for (quint64 i = t; i < h; ++i) f(events_[(int)(i % Capacity)]);
+    tail_.store(h, std::memory_order_release);
+    return (int)(h - t);
+  }
+
+  const int tid;
+  const QString threadName;
+  /// Set when the thread exited. The buffer is deleted once drained.
+  std::atomic<bool> orphan;
+
+ private:
+  QVector<Event> events_;
+  std::atomic<quint64> head_, tail_;
+};
+
+namespace {
+/// Mark the buffer of the thread as orphan when the thread exits.
+struct ThreadBuffer {
+  Tracer::Buffer* buffer;
+  ThreadBuffer() : buffer(NULL) {}
+  ~ThreadBuffer() {
+    if (buffer != NULL) buffer->orphan.store(true, std::memory_order_release);
+  }
+};
+thread_local ThreadBuffer threadBuffer;
+
+void writeString(QTextStream& os, const char* s) {
+  os << '"';
+  for (; *s != '\0'; ++s) {
+    switch (*s) {
+      case '"':
+        os << "\\\"";
+        break;
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      default:
+        if ((unsigned char)*s >= 0x20) os << *s;
+    }
+  }
+  os << '"';
+}
+}  // namespace
+
+Tracer& Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer()
+    : enabled_(!qgetenv("HPP_PLOT_TRACE").isEmpty()), dropped_(0), nextTid_(1) {
+  clock_.start();
+}
+
+void Tracer::enable(bool enable) {
+  enabled_.store(enable, std::memory_order_relaxed);
+}
+
+Tracer::Buffer* Tracer::buffer() {
+  if (threadBuffer.buffer == NULL) {
+    QThread* thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if (QCoreApplication::instance() != NULL &&
+        thread == QCoreApplication::instance()->thread())
+      name = "GUI";
+    QMutexLocker lock(&mutex_);
+    if (name.isEmpty()) name = QString("Thread %1").arg(nextTid_);
+    threadBuffer.buffer = new Buffer(nextTid_++, name);
+    buffers_.append(threadBuffer.buffer);
+  }
+  return threadBuffer.buffer;
+}
+
+void Tracer::record(const char* name, const char* category, qint64 ts,
+                    qint64 dur) {
+  Event e = {name, category, ts, dur};
+  if (!buffer()->push(e)) dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* Tracer::intern(const QString& name) {
+  QByteArray n = name.toUtf8();
+  QMutexLocker lock(&mutex_);
+  QSet<QByteArray>::const_iterator it = strings_.constFind(n);
+  if (it == strings_.constEnd()) it = strings_.insert(n);
+  return it->constData();
+}
+
+int Tracer::flush(QTextStream& os) {
+  qint64 pid = QCoreApplication::applicationPid();
+  QMutexLocker lock(&mutex_);
+  int n = 0;
+  bool first = true;
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (int i = 0; i < buffers_.size(); ++i) {
+    Buffer* b = buffers_[i];
+    if (!first) os << ",\n";
+    first = false;
+    os << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+       << ",\"tid\":" << b->tid << ",\"args\":{\"name\":";
+    writeString(os, b->threadName.toUtf8().constData());
+    os << "}}";
+    // Once the thread exited, nothing more is written in its buffer.
+    bool orphan = b->orphan.load(std::memory_order_acquire);
+    n += b->drain([&](const Event& e) {
+      os << ",\n{\"ph\":\"X\",\"name\":";
+      writeString(os, e.name);
+      os << ",\"cat\":";
+      writeString(os, e.category);
+      os << ",\"pid\":" << pid << ",\"tid\":" << b->tid << ",\"ts\":" << e.ts
+         << ",\"dur\":" << e.dur << '}';
+    });
+    if (orphan) {
+      delete b;
+      buffers_.removeAt(i--);
+    }
+  }
+  os << "\n]}\n";
+  return n;
+}
+
+int Tracer::flush(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return -1;
+  QTextStream os(&file);
+  return flush(os);
+}
+}  // namespace plot
+}  // namespace hpp